@@ -0,0 +1,103 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+#define ARENA_ALIGNMENT sizeof(void *)
+
+void initArena(Arena *arena)
+{
+    arena->head = NULL;
+}
+
+/*
+    Allocations are bump-pointer carved out of the head block. When it runs
+    out a new block is pushed in front of it, big enough for the request,
+    so there is no upper limit on a single allocation. Nothing is freed
+    individually, everything goes at once in freeArena.
+*/
+void *arenaAlloc(Arena *arena, size_t size)
+{
+    size = (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+
+    ArenaBlock *block = arena->head;
+    if (block == NULL || block->used + size > block->size)
+    {
+        size_t blockSize = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+        block = (ArenaBlock *)malloc(sizeof(ArenaBlock) + blockSize);
+        if (!block)
+        {
+            fprintf(stderr, "Memory allocation failed.\n");
+            exit(EXIT_FAILURE);
+        }
+        block->next = arena->head;
+        block->size = blockSize;
+        block->used = 0;
+        arena->head = block;
+    }
+
+    void *memory = block->data + block->used;
+    block->used += size;
+    return memory;
+}
+
+char *arenaStrndup(Arena *arena, const char *source, size_t length)
+{
+    char *copy = (char *)arenaAlloc(arena, length + 1);
+    memcpy(copy, source, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+// Forget every allocation but keep the oldest block around for the next round
+void arenaReset(Arena *arena)
+{
+    while (arena->head != NULL && arena->head->next != NULL)
+    {
+        ArenaBlock *next = arena->head->next;
+        free(arena->head);
+        arena->head = next;
+    }
+    if (arena->head != NULL)
+    {
+        arena->head->used = 0;
+    }
+}
+
+void freeArena(Arena *arena)
+{
+    arenaReset(arena);
+    free(arena->head);
+    arena->head = NULL;
+}
+
+// Reads a whole stream into the arena, null-terminated, without needing to seek
+char *arenaReadFile(Arena *arena, FILE *file, size_t *length)
+{
+    size_t capacity = ARENA_BLOCK_SIZE;
+    size_t size = 0;
+    char *buffer = (char *)arenaAlloc(arena, capacity + 1);
+
+    size_t bytesRead;
+    while ((bytesRead = fread(buffer + size, 1, capacity - size, file)) > 0)
+    {
+        size += bytesRead;
+        if (size == capacity)
+        {
+            // Out of room, move to a buffer twice as big; the old one is reclaimed with the arena
+            char *grown = (char *)arenaAlloc(arena, capacity * 2 + 1);
+            memcpy(grown, buffer, size);
+            buffer = grown;
+            capacity *= 2;
+        }
+    }
+
+    buffer[size] = '\0';
+    *length = size;
+    return buffer;
+}
+
+#endif
@@ -0,0 +1,599 @@
+#ifndef ASSEMBLER_H
+#define ASSEMBLER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
+#include <stdbool.h>
+
+/*
+    What the first pass needs from one line: the label it defines, where a
+    .ORIG moves the location counter, and how many words the line takes.
+    Tokens are views into the line, so label points into it.
+*/
+void summarizeLine(const char *sourceLine, size_t sourceLineLength, LineSummary *summary)
+{
+    summary->label = NULL;
+    summary->labelLength = 0;
+    summary->origin = -1;
+    summary->size = 0;
+    summary->ends = false;
+
+    size_t cursor = 0;
+    TokenView token;
+    if (!nextTokenView(sourceLine, sourceLineLength, &cursor, &token) || token.start[0] == ';') 
+    {
+        // Ignore lines that are empty or only a comment
+        return;
+    }
+
+    if (!isInstructionOrDirectiveView(token)) 
+    {
+        // A leading token that is not an instruction is a label when it stands alone or is followed by one
+        TokenView nextToken;
+        bool hasNext = nextTokenView(sourceLine, sourceLineLength, &cursor, &nextToken) && nextToken.start[0] != ';';
+        if (!hasNext || isInstructionOrDirectiveView(nextToken) || isSoloLabelView(token)) 
+        {
+            summary->label = token.start;
+            summary->labelLength = token.length;
+            if (token.start[token.length - 1] == ':') 
+            {
+                summary->labelLength--;
+            }
+        }
+        if (!hasNext) 
+        {
+            return;
+        }
+        token = nextToken;
+    }
+
+    // The number of words this line occupies
+    TokenView operand;
+    if (viewEquals(token, ".ORIG"))
+    {
+        if (nextTokenView(sourceLine, sourceLineLength, &cursor, &operand) && operand.start[0] == 'x')
+        {
+            operand.start++;
+            operand.length--;
+            int origin = viewToInt(operand, 16);
+            if (origin <= 0xFFFF)
+            {
+                // Pass 2 rejects anything larger and leaves the location counter alone
+                summary->origin = origin;
+                LOG_TRACE("Starting Address: x%X\n", summary->origin);
+            }
+        }
+    }
+    else if (viewEquals(token, ".BLKW"))
+    {
+        int blockSize = nextTokenView(sourceLine, sourceLineLength, &cursor, &operand) ? viewToInt(operand, 10) : 0;
+        if (blockSize > 0)
+        {
+            LOG_TRACE("Valid .BLKW directive with block size: %d.\n", blockSize);
+            summary->size = blockSize;
+        }
+    }
+    else if (viewEquals(token, ".STRINGZ"))
+    {
+        int length = decodeStringLiteral(sourceLine, sourceLineLength, &cursor, NULL);
+        if (length >= 0)
+        {
+            summary->size = length + 1;
+        }
+    }
+    else if (viewEquals(token, ".END"))
+    {
+        summary->ends = true;
+    }
+    else 
+    {
+        // Instructions and .FILL take one word each
+        summary->size = 1;
+    }
+}
+
+/*
+    The second pass over one line: parse it, encode it and hand the words
+    to context->writer. Returns the location counter after the line.
+*/
+int assembleLine(InstructionContext *context, const char *sourceLine, size_t sourceLineLength, int lineNum, int currentAddress)
+{
+    arenaReset(context->scratch);
+
+    Lexer lexer;
+    initLexer(&lexer, sourceLine, sourceLineLength, context->scratch);
+    char *tokenBuffer = allocTokenBuffer(&lexer);
+    int tokenIndex = 0;
+    bool firstToken = true;
+    bool isInstruction = false; // Instructions take one word whether or not they assemble cleanly
+    Tokens tokenType = INVALID_TOKEN;
+
+    while (lexer.index < lexer.length) 
+    {
+        char ch = peek(&lexer, 0);
+
+        if (isspace(ch)) 
+        {
+            consume(&lexer);
+            continue;
+        }
+
+        if (ch == ';' || ch == '\0' || ch == '\n') 
+        {
+            break;
+        }
+
+        if (ch == '.') 
+        {
+            consume(&lexer);
+
+            while (!isspace(peek(&lexer, 0)) && peek(&lexer, 0) != '\0') 
+            {
+                tokenBuffer[tokenIndex++] = lexer.source[lexer.index++];
+            }
+            tokenBuffer[tokenIndex] = '\0';
+
+            if (strcmp(tokenBuffer, "ORIG") == 0) 
+            {
+                unsigned int address;
+                if (parseORIG(&lexer, &address)) 
+                {
+                    LOG_TRACE("Found .ORIG directive with address x%X (VALID)\n", address);
+
+                    emitOrigin(context->writer, (uint16_t)address);
+                    currentAddress = address;
+                } 
+                else 
+                {
+                    LOG_ERROR("Failed to parse address for .ORIG directive.\n");
+                }
+            }
+            else if (strcmp(tokenBuffer, "FILL") == 0) 
+            {
+                int immValue;
+                currentAddress++;
+                if (parseFILL(&lexer, &immValue)) 
+                {
+                    LOG_TRACE("Valid .FILL directive with value: %d.\n", immValue);
+
+                    emitFill(context->writer, (uint16_t)immValue);
+                } 
+                else 
+                {
+                    LOG_ERROR("Failed to parse or invalid operand for .FILL directive.\n");
+                    emitPlaceholderWord(context->writer);
+                }
+            }
+            else if (strcmp(tokenBuffer, "END") == 0) 
+            {
+                if (parseEND(&lexer)) 
+                {
+                    LOG_TRACE("End of program found.\n");
+                    emitEnd(context->writer);
+                } 
+                else 
+                {
+                    LOG_ERROR("Invalid format for .END directive.\n");
+                }
+            }
+            else if (strcmp(tokenBuffer, "STRINGZ") == 0) 
+            {
+                char *characters = allocTokenBuffer(&lexer);
+                int length;
+                if (parseSTRINGZ(&lexer, characters, &length)) 
+                {
+                    LOG_TRACE("Valid .STRINGZ directive with %d characters.\n", length);
+
+                    emitString(context->writer, characters, length);
+                    currentAddress += length + 1; // Characters plus the terminating zero
+                } 
+                else 
+                {
+                    LOG_ERROR("Failed to parse string literal for .STRINGZ directive.\n");
+                    lexer.index = lexer.length; // The rest of the line is the broken literal
+                }
+            }
+            else if (strcmp(tokenBuffer, "BLKW") == 0) 
+            {
+                int blockSize;
+                int fillValue;
+                bool parsed = parseBLKW(&lexer, &blockSize, &fillValue);
+                if (parsed && blockSize <= LC3_MEMORY_WORDS - currentAddress) 
+                {
+                    LOG_TRACE("Valid .BLKW directive with block size: %d.\n", blockSize);
+
+                    emitReserved(context->writer, blockSize, (uint16_t)fillValue);
+                    currentAddress += blockSize;
+                } 
+                else 
+                {
+                    if (parsed)
+                    {
+                        LOG_ERROR(".BLKW block at x%04X runs past the end of memory.\n", currentAddress);
+                    }
+                    else
+                    {
+                        LOG_ERROR("Failed to parse or invalid block size for .BLKW directive.\n");
+                    }
+
+                    /*
+                        Move past the words pass 1 counted for the line, so the
+                        labels after it keep their addresses, but only fill the
+                        ones that are still inside memory.
+                    */
+                    LineSummary summary;
+                    summarizeLine(sourceLine, sourceLineLength, &summary);
+                    int words = summary.size < LC3_MEMORY_WORDS - currentAddress ? summary.size : LC3_MEMORY_WORDS - currentAddress;
+                    if (words > 0)
+                    {
+                        emitReserved(context->writer, words, 0);
+                    }
+                    currentAddress += summary.size;
+                    lexer.index = lexer.length;
+                }
+            }
+
+            continue;
+        }
+
+        tokenBuffer[tokenIndex++] = consume(&lexer);
+
+        if (isspace(peek(&lexer, 0)) || peek(&lexer, 0) == '\0') 
+        {
+            tokenBuffer[tokenIndex] = '\0';
+            tokenIndex = 0;
+
+            if (strncmp(tokenBuffer, "BR", 2) == 0) 
+            {
+                isInstruction = true;
+                if (!assembleInstruction(&instructionDescriptors[BR], tokenBuffer, &lexer, context, currentAddress))
+                {
+                    emitPlaceholderWord(context->writer);
+                }
+            }
+            else 
+            {
+                tokenType = validateToken(tokenBuffer);
+                if (firstToken && tokenType == INVALID_TOKEN) 
+                {
+                    if (isLabelDefinition(tokenBuffer)) 
+                    {
+                        LOG_TRACE("Label defined: %s\n", tokenBuffer);
+                        if (context->fixups != NULL)
+                        {
+                            size_t labelLen = strlen(tokenBuffer);
+                            if (tokenBuffer[labelLen - 1] == ':')
+                            {
+                                tokenBuffer[labelLen - 1] = '\0';
+                            }
+                            if (!addLabel(context->symbols, tokenBuffer, strlen(tokenBuffer), lineNum + 1, currentAddress))
+                            {
+                                LOG_ERROR("Duplicate label: %s\n", tokenBuffer);
+                            }
+                            else
+                            {
+                                resolveFixups(context->fixups, findSymbol(context->symbols, tokenBuffer), context->writer);
+                            }
+                        }
+                    } 
+                    else 
+                    {
+                        LOG_ERROR("Invalid token or unrecognized label: %s\n", tokenBuffer);
+                    }
+                    firstToken = false;
+                }
+                if (isInstructionToken(tokenType))
+                {
+                    isInstruction = true;
+                    if (!assembleInstruction(&instructionDescriptors[tokenType], tokenBuffer, &lexer, context, currentAddress))
+                    {
+                        emitPlaceholderWord(context->writer);
+                    }
+                }
+            }
+        }
+    }
+
+    if (isInstruction) 
+    {
+        currentAddress++;
+    }
+    return currentAddress;
+}
+
+/*
+    Runs both passes (or the one pass in single-pass mode) over every line
+    the reader hands out. context's symbols, fixups and writer must be
+    empty; in single-pass mode context->fixups must not be NULL.
+*/
+void assembleLines(LineReader *reader, InstructionContext *context, bool singlePass)
+{
+    SymbolTable *symbols = context->symbols;
+    const char *sourceLine;
+    size_t sourceLineLength;
+    int lineNum = 0;
+    int currentAddress = 0;
+    
+    // First pass: find every label and the word address it names
+    while (!singlePass && nextLine(reader, &sourceLine, &sourceLineLength)) 
+    {
+        lineNum++;
+
+        LineSummary summary;
+        summarizeLine(sourceLine, sourceLineLength, &summary);
+        if (summary.label != NULL && !addLabel(symbols, summary.label, summary.labelLength, lineNum, currentAddress))
+        {
+            LOG_ERROR("Duplicate label: %.*s\n", (int)summary.labelLength, summary.label);
+        }
+        if (summary.ends)
+        {
+            break;
+        }
+        currentAddress = (summary.origin >= 0 ? summary.origin : currentAddress) + summary.size;
+    }
+
+    if (LOG_ENABLED(VERBOSITY_TRACE))
+    {
+        fprintf(logStream, "Total Labels: %d\n", symbols->count);
+        for (int i = 0; i < symbols->count; i++) 
+        {
+            fprintf(logStream, "Label: %s, Line Number: %d\n", symbols->entries[i].label, symbols->entries[i].lineNum);
+        }
+        fprintf(logStream, "\n");
+
+        for (int i = 0; i < symbols->count; i++) 
+        {
+            fprintf(logStream, "Label: %s, Line Number: %d, Address: x%X\n", symbols->entries[i].label, symbols->entries[i].lineNum, symbols->entries[i].address);
+        }
+    }
+
+    rewindLineReader(reader);
+    lineNum = 0;
+    currentAddress = 0;
+
+    while (nextLine(reader, &sourceLine, &sourceLineLength)) 
+    {
+        currentAddress = assembleLine(context, sourceLine, sourceLineLength, lineNum, currentAddress);
+
+        if (singlePass)
+        {
+            flushOutputWriter(context->writer, firstOpenFixupEntry(context->fixups));
+        }
+
+        lineNum++;
+    }
+
+    if (singlePass)
+    {
+        reportUnresolvedFixups(context->fixups);
+        flushOutputWriter(context->writer, INT_MAX);
+    }
+}
+
+/*
+    Assembles one source into one output. Every bit of per-file state lives
+    on this stack frame or in the job, the shared tables are read-only, and
+    diagnostics go to this thread's logStream, so jobs can run in parallel.
+*/
+bool assembleFile(AssemblyJob *job)
+{
+    FILE *file = strcmp(job->inputPath, "-") == 0 ? stdin : fopen(job->inputPath, "r");
+    if (file == NULL) 
+    {
+        fprintf(logStream, "Error opening file %s!\n", job->inputPath);
+        return false;
+    }
+
+    FILE *binFile;
+    if (strcmp(job->outputPath, "-") == 0)
+    {
+        // Keep diagnostics out of the assembled output
+        binFile = stdout;
+        logStream = stderr;
+    }
+    else
+    {
+        binFile = fopen(job->outputPath, "wb");
+    }
+    if (binFile == NULL) 
+    {
+        fprintf(logStream, "Error opening file %s.\n", job->outputPath);
+        if (file != stdin)
+        {
+            fclose(file);
+        }
+        return false;
+    }
+
+    OutputFormat format = job->format;
+    bool singlePass = job->singlePass;
+    errorCount = 0;
+
+    OutputWriter writer;
+    initOutputWriter(&writer, binFile, format);
+    if (binFile != stdout)
+    {
+        // Nothing else writes to a file opened here, so its blocks can skip stdio
+        setOutputDescriptor(&writer.sink, fileno(binFile));
+    }
+    writer.deferred = singlePass;
+    writer.image = job->image;
+
+    Arena arena; // Source text and label names, freed once assembly is done
+    Arena scratch; // Line copies and token buffers, reset after every line
+    initArena(&arena);
+    initArena(&scratch);
+
+    /*
+        A regular file is mapped and both passes lex straight out of the
+        mapping. Anything else is streamed block by block in single-pass
+        mode, or read into memory once for the two passes.
+    */
+    LineReader reader;
+    size_t sourceLength;
+    const char *mappedSource = mapInputFile(file, &sourceLength);
+    if (mappedSource != NULL)
+    {
+        initBufferReader(&reader, mappedSource, sourceLength);
+    }
+    else if (singlePass)
+    {
+        initStreamReader(&reader, file);
+    }
+    else
+    {
+        const char *source = arenaReadFile(&arena, file, &sourceLength);
+        initBufferReader(&reader, source, sourceLength);
+    }
+
+    SymbolTable symbols;
+    initSymbolTable(&symbols, &arena);
+
+    // Only single-pass mode records fixups, two passes always know every label
+    FixupList fixupList;
+    initFixupList(&fixupList, &arena);
+
+    InstructionContext context;
+    context.symbols = &symbols;
+    context.fixups = singlePass ? &fixupList : NULL;
+    context.writer = &writer;
+    context.scratch = &scratch;
+    context.referencedLabel = NULL;
+
+    assembleLines(&reader, &context, singlePass);
+
+    exportSymbols(&symbols, job->outputPath, job->symbolExport);
+
+    if (file != stdin)
+    {
+        fclose(file);
+    }
+    freeLineReader(&reader);
+    if (mappedSource != NULL)
+    {
+        unmapInputFile(mappedSource, sourceLength);
+    }
+    freeOutputWriter(&writer);
+    freeFixupList(&fixupList);
+    freeSymbolTable(&symbols);
+    freeArena(&scratch);
+    freeArena(&arena);
+    if (binFile != stdout)
+    {
+        fclose(binFile);
+    }
+    else
+    {
+        fflush(binFile);
+    }
+    LOG_TRACE("Successfully converted the LC-3 ASM file to binary!\n");
+
+    job->errors = errorCount;
+    return true;
+}
+
+/*
+    The output and the diagnostics go to memory streams that live as long
+    as the AssemblyOutput, so their buffers grow to fit the largest source
+    seen and are then reused. The streams point back into the struct, so it
+    must stay where it was initialized.
+*/
+bool initAssemblyOutput(AssemblyOutput *output)
+{
+    output->bytes = NULL;
+    output->length = 0;
+    output->diagnostics = NULL;
+    output->diagnosticsLength = 0;
+    output->errors = 0;
+    output->outputStream = open_memstream(&output->bytes, &output->length);
+    output->diagnosticStream = open_memstream(&output->diagnostics, &output->diagnosticsLength);
+    if (output->outputStream == NULL || output->diagnosticStream == NULL)
+    {
+        if (output->outputStream != NULL)
+        {
+            fclose(output->outputStream);
+        }
+        if (output->diagnosticStream != NULL)
+        {
+            fclose(output->diagnosticStream);
+        }
+        free(output->bytes);
+        free(output->diagnostics);
+        return false;
+    }
+
+    initArena(&output->arena);
+    initArena(&output->scratch);
+    initSymbolTable(&output->symbols, &output->arena);
+    initFixupList(&output->fixups, &output->arena);
+    initOutputWriter(&output->writer, output->outputStream, FORMAT_LISTING);
+    return true;
+}
+
+void freeAssemblyOutput(AssemblyOutput *output)
+{
+    fclose(output->outputStream);
+    fclose(output->diagnosticStream);
+    free(output->bytes);
+    free(output->diagnostics);
+    freeOutputWriter(&output->writer);
+    freeFixupList(&output->fixups);
+    freeSymbolTable(&output->symbols);
+    freeArena(&output->scratch);
+    freeArena(&output->arena);
+}
+
+/*
+    Assembles source, which needs no terminating null, entirely in memory:
+    no file is opened, and the streams, tables and arenas of the previous
+    call are reused instead of being built again. Afterwards output->bytes holds the listing or object file,
+    output->diagnostics what was logged (null-terminated), output->symbols
+    the labels, and output->errors the error count. They stay valid until
+    the next call. Returns false when there were errors.
+*/
+bool assemble(const char *source, size_t length, AssemblyOptions options, AssemblyOutput *output)
+{
+    FILE *log = logStream;
+    Verbosity savedVerbosity = verbosity;
+    logStream = output->diagnosticStream;
+    verbosity = options.verbosity;
+    errorCount = 0;
+
+    rewind(output->outputStream);
+    rewind(output->diagnosticStream);
+    arenaReset(&output->arena);
+    clearSymbolTable(&output->symbols);
+    clearFixupList(&output->fixups);
+    resetOutputWriter(&output->writer, options.format);
+    output->writer.deferred = options.singlePass;
+    output->writer.image = options.image;
+
+    LineReader reader;
+    initBufferReader(&reader, source, length);
+
+    InstructionContext context;
+    context.symbols = &output->symbols;
+    context.fixups = options.singlePass ? &output->fixups : NULL;
+    context.writer = &output->writer;
+    context.scratch = &output->scratch;
+    context.referencedLabel = NULL;
+
+    assembleLines(&reader, &context, options.singlePass);
+
+    flushOutputSink(&output->writer.sink);
+    fflush(output->outputStream);
+    // The stream only terminates what it has not written before, so the diagnostics get their own null
+    fputc('\0', output->diagnosticStream);
+    fflush(output->diagnosticStream);
+    output->diagnosticsLength--;
+
+    output->errors = errorCount;
+    logStream = log;
+    verbosity = savedVerbosity;
+    return output->errors == 0;
+}
+
+#endif
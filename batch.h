@@ -0,0 +1,288 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+// foo.asm becomes foo.bin or foo.obj next to it, anything else just gets the extension appended
+char *outputPathFor(const char *inputPath, OutputFormat format)
+{
+    const char *extension = format == FORMAT_OBJECT ? ".obj" : ".bin";
+    size_t length = strlen(inputPath);
+    if (length > 4 && strcmp(inputPath + length - 4, ".asm") == 0)
+    {
+        length -= 4;
+    }
+
+    char *outputPath = (char *)malloc(length + strlen(extension) + 1);
+    if (!outputPath)
+    {
+        fprintf(stderr, "Memory allocation failed.\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(outputPath, inputPath, length);
+    strcpy(outputPath + length, extension);
+    return outputPath;
+}
+
+bool addBatchJob(AssemblyJob **jobs, int *jobCount, int *capacity, const char *inputPath, OutputFormat format, bool singlePass)
+{
+    if (*jobCount == *capacity)
+    {
+        int grown = *capacity ? *capacity * 2 : 64;
+        AssemblyJob *entries = (AssemblyJob *)realloc(*jobs, grown * sizeof(AssemblyJob));
+        if (!entries)
+        {
+            fprintf(stderr, "Memory allocation failed.\n");
+            exit(EXIT_FAILURE);
+        }
+        *jobs = entries;
+        *capacity = grown;
+    }
+
+    char *path = strdup(inputPath);
+    if (!path)
+    {
+        fprintf(stderr, "Memory allocation failed.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    AssemblyJob *job = &(*jobs)[(*jobCount)++];
+    job->inputPath = path;
+    job->outputPath = outputPathFor(path, format);
+    job->format = format;
+    job->singlePass = singlePass;
+    job->image = NULL;
+    job->symbolExport = SYMBOLS_NONE;
+    job->cache = NULL;
+    job->errors = 0;
+    return true;
+}
+
+int compareJobs(const void *a, const void *b)
+{
+    return strcmp(((const AssemblyJob *)a)->inputPath, ((const AssemblyJob *)b)->inputPath);
+}
+
+/*
+    A directory contributes every *.asm directly inside it, in name order.
+    Anything else is read as a list with one source path per line, blank
+    lines and lines starting with ';' skipped.
+*/
+bool collectBatchJobs(const char *batchPath, OutputFormat format, bool singlePass, AssemblyJob **jobs, int *jobCount)
+{
+    int capacity = 0;
+    *jobs = NULL;
+    *jobCount = 0;
+
+    struct stat info;
+    if (strcmp(batchPath, "-") != 0 && stat(batchPath, &info) == 0 && S_ISDIR(info.st_mode))
+    {
+        DIR *directory = opendir(batchPath);
+        if (directory == NULL)
+        {
+            fprintf(stderr, "Error opening directory %s.\n", batchPath);
+            return false;
+        }
+
+        struct dirent *entry;
+        while ((entry = readdir(directory)) != NULL)
+        {
+            size_t length = strlen(entry->d_name);
+            if (length <= 4 || strcmp(entry->d_name + length - 4, ".asm") != 0)
+            {
+                continue;
+            }
+
+            char *path = (char *)malloc(strlen(batchPath) + length + 2);
+            if (!path)
+            {
+                fprintf(stderr, "Memory allocation failed.\n");
+                exit(EXIT_FAILURE);
+            }
+            sprintf(path, "%s/%s", batchPath, entry->d_name);
+            addBatchJob(jobs, jobCount, &capacity, path, format, singlePass);
+            free(path);
+        }
+        closedir(directory);
+
+        qsort(*jobs, *jobCount, sizeof(AssemblyJob), compareJobs);
+        return true;
+    }
+
+    FILE *list = strcmp(batchPath, "-") == 0 ? stdin : fopen(batchPath, "r");
+    if (list == NULL)
+    {
+        fprintf(stderr, "Error opening batch list %s.\n", batchPath);
+        return false;
+    }
+
+    LineReader reader;
+    initStreamReader(&reader, list);
+    const char *line;
+    size_t lineLength;
+    while (nextLine(&reader, &line, &lineLength))
+    {
+        size_t cursor = 0;
+        TokenView path;
+        if (!nextTokenView(line, lineLength, &cursor, &path) || path.start[0] == ';')
+        {
+            continue;
+        }
+
+        // Paths may contain spaces, so only trailing whitespace is dropped
+        size_t end = lineLength;
+        while (end > cursor - path.length && isspace((unsigned char)line[end - 1]))
+        {
+            end--;
+        }
+        char *inputPath = strndup(path.start, line + end - path.start);
+        if (!inputPath)
+        {
+            fprintf(stderr, "Memory allocation failed.\n");
+            exit(EXIT_FAILURE);
+        }
+        addBatchJob(jobs, jobCount, &capacity, inputPath, format, singlePass);
+        free(inputPath);
+    }
+    freeLineReader(&reader);
+    if (list != stdin)
+    {
+        fclose(list);
+    }
+    return true;
+}
+
+/*
+    Each job logs into its own memory buffer and the whole buffer is
+    written out in one locked step when the job is done, so output from
+    different files never interleaves.
+*/
+void *batchWorker(void *arg)
+{
+    JobQueue *queue = (JobQueue *)arg;
+    verbosity = queue->verbosity;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&queue->lock);
+        int index = queue->nextJob < queue->jobCount ? queue->nextJob++ : -1;
+        pthread_mutex_unlock(&queue->lock);
+        if (index == -1)
+        {
+            break;
+        }
+
+        AssemblyJob *job = &queue->jobs[index];
+        char *log = NULL;
+        size_t logLength = 0;
+        logStream = open_memstream(&log, &logLength);
+        if (logStream == NULL)
+        {
+            logStream = stderr;
+        }
+
+        bool assembled = assembleJob(job);
+
+        if (logStream != stderr)
+        {
+            fclose(logStream);
+        }
+        logStream = stdout;
+
+        flockfile(stdout);
+        if (logLength > 0)
+        {
+            printf("== %s\n", job->inputPath);
+            fwrite(log, 1, logLength, stdout);
+        }
+        funlockfile(stdout);
+        free(log);
+
+        if (!assembled || job->errors > 0)
+        {
+            pthread_mutex_lock(&queue->lock);
+            queue->failedJobs++;
+            pthread_mutex_unlock(&queue->lock);
+        }
+    }
+    return NULL;
+}
+
+// Assembles every source named by batchPath, false if any of them failed or had errors
+bool runBatch(const char *batchPath, OutputFormat format, bool singlePass, int symbolExport, AssemblyCache *cache, int threadCount)
+{
+    JobQueue queue;
+    if (!collectBatchJobs(batchPath, format, singlePass, &queue.jobs, &queue.jobCount))
+    {
+        return false;
+    }
+
+    int i;
+    for (i = 0; i < queue.jobCount; i++)
+    {
+        queue.jobs[i].symbolExport = symbolExport;
+        queue.jobs[i].cache = cache;
+    }
+    queue.nextJob = 0;
+    queue.failedJobs = 0;
+    queue.verbosity = verbosity;
+    pthread_mutex_init(&queue.lock, NULL);
+
+    if (threadCount <= 0)
+    {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        threadCount = cores > 0 ? (int)cores : 1;
+    }
+    if (threadCount > queue.jobCount)
+    {
+        threadCount = queue.jobCount > 0 ? queue.jobCount : 1;
+    }
+
+    pthread_t *threads = (pthread_t *)malloc(threadCount * sizeof(pthread_t));
+    if (!threads)
+    {
+        fprintf(stderr, "Memory allocation failed.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    int started = 0;
+    for (i = 0; i < threadCount; i++)
+    {
+        if (pthread_create(&threads[i], NULL, batchWorker, &queue) != 0)
+        {
+            break;
+        }
+        started++;
+    }
+    if (started == 0)
+    {
+        // No threads to be had, run the queue on this one
+        batchWorker(&queue);
+    }
+    for (i = 0; i < started; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    LOG_TRACE("Assembled %d files on %d threads, %d failed.\n", queue.jobCount, started, queue.failedJobs);
+
+    for (i = 0; i < queue.jobCount; i++)
+    {
+        free((char *)queue.jobs[i].inputPath);
+        free((char *)queue.jobs[i].outputPath);
+    }
+    free(queue.jobs);
+    free(threads);
+    pthread_mutex_destroy(&queue.lock);
+
+    return queue.failedJobs == 0;
+}
+
+#endif
@@ -0,0 +1,960 @@
+#ifndef BENCHMARKS_H
+#define BENCHMARKS_H
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// The strcmp chains validateToken and validateRegisterToken used to be, kept as the baseline
+Tokens validateTokenChain(const char *token)
+{
+    if (strcmp(token, "ADD") == 0) return ADD;
+    else if (strcmp(token, "AND") == 0) return AND;
+    else if (strncmp(token, "BR", 2) == 0 && strlen(token) == 2) return BR;
+    else if (strcmp(token, "LD") == 0) return LD;
+    else if (strcmp(token, "LDI") == 0) return LDI;
+    else if (strcmp(token, "LDR") == 0) return LDR;
+    else if (strcmp(token, "LEA") == 0) return LEA;
+    else if (strcmp(token, "NOT") == 0) return NOT;
+    else if (strcmp(token, "ST") == 0) return ST;
+    else if (strcmp(token, "STI") == 0) return STI;
+    else if (strcmp(token, "STR") == 0) return STR;
+    else if (strcmp(token, "TRAP") == 0) return TRAP;
+    else if (strcmp(token, "ORIG") == 0) return ORIG;
+    else if (strcmp(token, "END") == 0) return END;
+    else if (strcmp(token, "#") == 0) return HASH;
+    else if (strcmp(token, ";") == 0) return SEMI;
+    else if (strcmp(token, "BLKW") == 0) return BLKW;
+    else if (strcmp(token, ".FILL") == 0) return FILL;
+    return INVALID_TOKEN;
+}
+
+RegisterTokens validateRegisterTokenChain(const char *regstr)
+{
+    static const char *names[] = {"R0", "R1", "R2", "R3", "R4", "R5", "R6", "R7"};
+    int i;
+    for (i = 0; i < 8; i++)
+    {
+        if (strcmp(regstr, names[i]) == 0) return (RegisterTokens)i;
+    }
+    return INVALID_REGISTER;
+}
+
+/*
+    Times both classifiers over a token mix shaped like real source:
+    mnemonics, labels (which fall through every comparison) and registers.
+    Both versions are checked to agree on every token before timing.
+*/
+void runClassifierBenchmark(void)
+{
+    static const char *tokens[] = {
+        "ADD", "AND", "BR", "LD", "LDI", "LDR", "LEA", "NOT", "ST", "STI", "STR", "TRAP",
+        "ORIG", "END", "BLKW", ".FILL", "#", ";", "LOOP", "NUMX", "RESULT", "HALT:", "BRnzp", "X",
+        "R0", "R3", "R7", "R8", "r1", "R10"
+    };
+    const int tokenCount = sizeof(tokens) / sizeof(tokens[0]);
+    const int rounds = 2000000;
+    int i, round;
+
+    for (i = 0; i < tokenCount; i++)
+    {
+        if (validateToken(tokens[i]) != validateTokenChain(tokens[i]) || validateRegisterToken(tokens[i]) != validateRegisterTokenChain(tokens[i]))
+        {
+            printf("Classifier mismatch on '%s'\n", tokens[i]);
+            return;
+        }
+    }
+
+    // volatile pointers keep the compiler from hoisting the calls out of the loop
+    const char *volatile *tokenList = (const char *volatile *)tokens;
+    volatile unsigned sink = 0;
+
+    double start = monotonicSeconds();
+    for (round = 0; round < rounds; round++)
+    {
+        for (i = 0; i < tokenCount; i++)
+        {
+            sink += validateTokenChain(tokenList[i]) + validateRegisterTokenChain(tokenList[i]);
+        }
+    }
+    double chainTime = monotonicSeconds() - start;
+
+    start = monotonicSeconds();
+    for (round = 0; round < rounds; round++)
+    {
+        for (i = 0; i < tokenCount; i++)
+        {
+            sink += validateToken(tokenList[i]) + validateRegisterToken(tokenList[i]);
+        }
+    }
+    double dispatchTime = monotonicSeconds() - start;
+
+    double lookups = (double)rounds * tokenCount;
+    printf("Token + register classification, %.0f lookups each\n", lookups);
+    printf("  strcmp chain:       %6.2f ns/token\n", chainTime * 1e9 / lookups);
+    printf("  length dispatch:    %6.2f ns/token\n", dispatchTime * 1e9 / lookups);
+    printf("  speedup:            %6.2fx\n", chainTime / dispatchTime);
+}
+
+// Appends one instruction to a generated benchmark program; operand is SR2, the immediate or the offset
+void benchInstruction(MemoryImage *image, BinOps binaryOps, int dr, int sr1, int operand)
+{
+    Operands operands;
+    operands.dr = dr;
+    operands.sr1 = sr1;
+    operands.sr2 = operand;
+    operands.imm = operand;
+    operands.conditions = dr;
+    operands.immediate = false;
+    storeImageWord(image, encodeInstruction(binaryOps, &operands));
+}
+
+/*
+    The LOOPADD loop from file.asm, wrapped in an outer loop so it runs
+    long enough to time:
+
+            LD R1, NUMX
+            LD R5, OUTER
+    OUTERL  AND R3, R3, #0
+            LD R2, INNER
+    LOOPADD ADD R3, R3, R1
+            ADD R2, R2, #-1
+            BRp LOOPADD
+            ADD R5, R5, #-1
+            BRp OUTERL
+            HALT
+*/
+void buildLoopAddProgram(MemoryImage *image, int outerCount, int innerCount)
+{
+    initMemoryImage(image);
+    image->origin = 0x3000;
+    image->originSet = true;
+    image->cursor = 0x3000;
+
+    benchInstruction(image, LD_OP, R1, 0, 9);
+    benchInstruction(image, LD_OP, R5, 0, 9);
+    benchInstruction(image, AND_TWO_OP, R3, R3, 0);
+    benchInstruction(image, LD_OP, R2, 0, 8);
+    benchInstruction(image, ADD_ONE_OP, R3, R3, R1);
+    benchInstruction(image, ADD_TWO_OP, R2, R2, -1);
+    benchInstruction(image, BR_OP, CONDITION_P, 0, -3);
+    benchInstruction(image, ADD_TWO_OP, R5, R5, -1);
+    benchInstruction(image, BR_OP, CONDITION_P, 0, -7);
+    benchInstruction(image, TRAP_OP, 0, 0, 0x25);
+    storeImageWord(image, 11);
+    storeImageWord(image, (uint16_t)outerCount);
+    storeImageWord(image, (uint16_t)innerCount);
+}
+
+/*
+    A loop around bodyLength pseudo-random ALU, load/store and short
+    forward branch instructions on R0-R3, with R4 pointing at a 32-word
+    data block and R6 counting iterations. bodyLength must stay under
+    about 240 so every PC offset fits.
+*/
+void buildGeneratedLoopProgram(MemoryImage *image, int bodyLength, int iterations, unsigned int seed)
+{
+    initMemoryImage(image);
+    image->origin = 0x3000;
+    image->originSet = true;
+    image->cursor = 0x3000;
+
+    int countAddress = 0x3000 + 2 + bodyLength + 3;
+    int dataAddress = countAddress + 1;
+
+    benchInstruction(image, LEA_OP, R4, 0, dataAddress - 0x3001);
+    benchInstruction(image, LD_OP, R6, 0, countAddress - 0x3002);
+    int loopAddress = image->cursor;
+
+    int i;
+    for (i = 0; i < bodyLength; i++)
+    {
+        seed = seed * 1103515245u + 12345u;
+        unsigned int bits = seed >> 8;
+        int dr = bits & 0x3;
+        int sr1 = (bits >> 2) & 0x3;
+        int sr2 = (bits >> 4) & 0x3;
+        int imm = (int)((bits >> 6) & 0x1F) - 16;
+        switch ((bits >> 12) % 8)
+        {
+            case 0: benchInstruction(image, ADD_ONE_OP, dr, sr1, sr2); break;
+            case 1: benchInstruction(image, ADD_TWO_OP, dr, sr1, imm); break;
+            case 2: benchInstruction(image, AND_ONE_OP, dr, sr1, sr2); break;
+            case 3: benchInstruction(image, AND_TWO_OP, dr, sr1, imm); break;
+            case 4: benchInstruction(image, NOT_OP, dr, sr1, 0); break;
+            case 5: benchInstruction(image, LDR_OP, dr, R4, imm & 0x1F); break;
+            case 6: benchInstruction(image, STR_OP, dr, R4, imm & 0x1F); break;
+            default:
+                // Skip the next body instruction, never the loop counter
+                benchInstruction(image, BR_OP, i < bodyLength - 1 ? CONDITION_Z : 0, 0, 1);
+                break;
+        }
+    }
+
+    benchInstruction(image, ADD_TWO_OP, R6, R6, -1);
+    benchInstruction(image, BR_OP, CONDITION_P, 0, loopAddress - (image->cursor + 1));
+    benchInstruction(image, TRAP_OP, 0, 0, 0x25);
+    storeImageWord(image, (uint16_t)iterations);
+}
+
+/*
+    Runs each program under every dispatch mode, checks they all end in
+    the same state, and reports the best of three runs per mode.
+*/
+void runSimulatorBenchmark(void)
+{
+    MemoryImage *image = (MemoryImage *)malloc(sizeof(MemoryImage));
+    Machine *machines[3] = { (Machine *)malloc(sizeof(Machine)), (Machine *)malloc(sizeof(Machine)), (Machine *)malloc(sizeof(Machine)) };
+    if (!image || !machines[0] || !machines[1] || !machines[2])
+    {
+        fprintf(stderr, "Memory allocation failed.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    static const char *names[] = { "file.asm LOOPADD loop", "generated 200-instruction loop" };
+    static const DispatchMode modes[] = { DISPATCH_SWITCH, DISPATCH_THREADED, DISPATCH_JIT };
+    int program, mode, round;
+
+    if (!LC3_THREADED_DISPATCH)
+    {
+        printf("Computed goto is not available, threaded dispatch falls back to the switch\n");
+    }
+    if (!LC3_JIT_AVAILABLE)
+    {
+        printf("No JIT for this platform, jit falls back to threaded dispatch\n");
+    }
+
+    for (program = 0; program < 2; program++)
+    {
+        if (program == 0)
+        {
+            buildLoopAddProgram(image, 300, 30000);
+        }
+        else
+        {
+            buildGeneratedLoopProgram(image, 200, 30000, 2024);
+        }
+
+        double best[3];
+        for (mode = 0; mode < 3; mode++)
+        {
+            best[mode] = 0;
+            for (round = 0; round < 3; round++)
+            {
+                loadMachine(machines[mode], image, stdin, stdout);
+                double start = monotonicSeconds();
+                RunResult result = runProgram(machines[mode], modes[mode], 0);
+                double elapsed = monotonicSeconds() - start;
+                if (result != RUN_HALTED)
+                {
+                    printf("%s did not halt\n", names[program]);
+                    return;
+                }
+                if (round == 0 || elapsed < best[mode])
+                {
+                    best[mode] = elapsed;
+                }
+            }
+        }
+
+        if (!sameMachineState(machines[0], machines[1]) || !sameMachineState(machines[0], machines[2]))
+        {
+            printf("Dispatch mismatch on %s\n", names[program]);
+            return;
+        }
+
+        double instructions = (double)machines[0]->executed;
+        printf("Simulator, %s, %.0f instructions\n", names[program], instructions);
+        printf("  switch:             %6.2f ns/instruction\n", best[0] * 1e9 / instructions);
+        printf("  threaded:           %6.2f ns/instruction\n", best[1] * 1e9 / instructions);
+        printf("  jit:                %6.2f ns/instruction\n", best[2] * 1e9 / instructions);
+        printf("  threaded speedup:   %6.2fx\n", best[0] / best[1]);
+        printf("  jit speedup:        %6.2fx\n", best[0] / best[2]);
+    }
+
+    free(machines[0]);
+    free(machines[1]);
+    free(machines[2]);
+    free(image);
+}
+
+unsigned int nextRandom(unsigned int *seed)
+{
+    *seed = *seed * 1103515245u + 12345u;
+    return *seed >> 8;
+}
+
+/*
+    Random code for the JIT self-check. The program starts by pointing R4
+    at itself, and the offsets mostly stay inside the program. Stores
+    therefore often rewrite code that has already been compiled, and
+    branches, JSR and JMP/RET loop around in it. OUT and HALT come up now
+    and then, and RTI and the reserved opcode only rarely.
+*/
+void buildRandomProgram(MemoryImage *image, unsigned int seed)
+{
+    initMemoryImage(image);
+    image->origin = 0x3000;
+    image->originSet = true;
+    image->cursor = 0x3000;
+
+    int length = 16 + nextRandom(&seed) % 160;
+    benchInstruction(image, LEA_OP, R4, 0, -1);
+
+    int i;
+    for (i = 1; i < length; i++)
+    {
+        unsigned int bits = nextRandom(&seed);
+        int dr = bits & 0x7;
+        int sr1 = (bits >> 3) & 0x7;
+        int sr2 = (bits >> 6) & 0x7;
+        int imm5 = (int)((bits >> 9) & 0x1F) - 16;
+        int offset6 = (int)((bits >> 9) & 0x3F) - 32;
+        int offset9 = (int)(nextRandom(&seed) % (length + 16)) - i - 1; // Somewhere in the program or just past it
+        int offset11 = offset9;
+        if (dr == R4 && (bits & 0x100000))
+        {
+            dr = R0; // Keep R4 pointing into the program most of the time
+        }
+
+        switch ((bits >> 15) % 20)
+        {
+            case 0: benchInstruction(image, ADD_ONE_OP, dr, sr1, sr2); break;
+            case 1: case 2: benchInstruction(image, ADD_TWO_OP, dr, sr1, imm5); break;
+            case 3: benchInstruction(image, AND_ONE_OP, dr, sr1, sr2); break;
+            case 4: benchInstruction(image, AND_TWO_OP, dr, sr1, imm5); break;
+            case 5: benchInstruction(image, NOT_OP, dr, sr1, 0); break;
+            case 6: benchInstruction(image, LD_OP, dr, 0, offset9); break;
+            case 7: benchInstruction(image, LDI_OP, dr, 0, offset9); break;
+            case 8: benchInstruction(image, LDR_OP, dr, R4, offset6 & 0x1F); break;
+            case 9: benchInstruction(image, LEA_OP, dr, 0, offset9); break;
+            case 10: benchInstruction(image, ST_OP, dr, 0, offset9); break;
+            case 11: benchInstruction(image, STI_OP, dr, 0, offset9); break;
+            case 12: benchInstruction(image, STR_OP, dr, (bits & 0x200000) ? R4 : sr1, offset6); break;
+            case 13: case 14: case 15: benchInstruction(image, BR_OP, sr2, 0, offset9); break;
+            case 16: benchInstruction(image, JSR_OP, 0, 0, offset11); break;
+            case 17:
+                if (bits & 0x400000)
+                {
+                    benchInstruction(image, RET_OP, 0, 0, 0);
+                }
+                else
+                {
+                    benchInstruction(image, (bits & 0x800000) ? JMP_OP : JSRR_OP, 0, sr1, 0);
+                }
+                break;
+            case 18: benchInstruction(image, TRAP_OP, 0, 0, (bits & 0x7) == 0 ? 0x25 : 0x21); break;
+            default:
+                if ((bits & 0xF) == 0)
+                {
+                    storeImageWord(image, (bits & 0x10) ? 0x8000 : 0xD000); // RTI or reserved
+                }
+                else
+                {
+                    benchInstruction(image, ADD_TWO_OP, dr, dr, 1);
+                }
+                break;
+        }
+    }
+    benchInstruction(image, TRAP_OP, 0, 0, 0x25);
+}
+
+bool sameMachineState(const Machine *a, const Machine *b)
+{
+    return a->executed == b->executed && a->pc == b->pc && a->conditions == b->conditions
+        && memcmp(a->registers, b->registers, sizeof(a->registers)) == 0
+        && memcmp(a->memory, b->memory, sizeof(a->memory)) == 0;
+}
+
+/*
+    Differential test of the JIT against the switch interpreter. Each
+    random program runs under both, and they must agree on how the run
+    ended, the registers, the condition codes, all of memory, the
+    instruction count and everything written to the output. The JIT
+    compiles at different thresholds so both tiers get covered, and some
+    runs stop at an instruction limit to check that its accounting is
+    exact.
+*/
+bool runJitSelfCheck(int programCount)
+{
+    if (!LC3_JIT_AVAILABLE)
+    {
+        printf("No JIT for this platform, nothing to check\n");
+        return true;
+    }
+
+    MemoryImage *image = (MemoryImage *)malloc(sizeof(MemoryImage));
+    Machine *reference = (Machine *)malloc(sizeof(Machine));
+    Machine *compiled = (Machine *)malloc(sizeof(Machine));
+    JitState *jit = (JitState *)malloc(sizeof(JitState));
+    FILE *input = tmpfile();
+    FILE *referenceOutput = tmpfile();
+    FILE *compiledOutput = tmpfile();
+    if (!image || !reference || !compiled || !jit || !input || !referenceOutput || !compiledOutput)
+    {
+        fprintf(stderr, "Memory allocation failed.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Faults are expected here, keep their messages out of the report
+    Verbosity savedVerbosity = verbosity;
+    verbosity = VERBOSITY_QUIET;
+
+    static const int thresholds[] = { 1, 2, 16 };
+    long long instructions = 0;
+    long long compiledBlocks = 0;
+    long long droppedBlocks = 0;
+    int failures = 0;
+    int program;
+    for (program = 0; program < programCount; program++)
+    {
+        buildRandomProgram(image, 0x5EED0000u + program);
+        long long limit = (program % 4 == 3) ? 1 + program % 997 : 200000;
+
+        rewind(referenceOutput);
+        rewind(compiledOutput);
+        loadMachine(reference, image, input, referenceOutput);
+        loadMachine(compiled, image, input, compiledOutput);
+
+        RunResult expected = runMachine(reference, limit);
+        if (!initJit(jit, thresholds[program % 3]))
+        {
+            printf("Could not map executable memory for the JIT\n");
+            break;
+        }
+        RunResult actual = runJit(compiled, jit, limit);
+        compiledBlocks += jit->compiledBlocks;
+        droppedBlocks += jit->droppedBlocks;
+        freeJit(jit);
+
+        long outputLength = ftell(referenceOutput);
+        bool sameOutput = outputLength == ftell(compiledOutput);
+        if (sameOutput && outputLength > 0)
+        {
+            char *expectedText = (char *)malloc(outputLength);
+            char *actualText = (char *)malloc(outputLength);
+            rewind(referenceOutput);
+            rewind(compiledOutput);
+            sameOutput = expectedText && actualText
+                && fread(expectedText, 1, outputLength, referenceOutput) == (size_t)outputLength
+                && fread(actualText, 1, outputLength, compiledOutput) == (size_t)outputLength
+                && memcmp(expectedText, actualText, outputLength) == 0;
+            free(expectedText);
+            free(actualText);
+        }
+
+        instructions += reference->executed;
+        if (expected != actual || !sameMachineState(reference, compiled) || !sameOutput)
+        {
+            printf("JIT mismatch on program %d (seed x%08X): ran %lld vs %lld instructions, pc x%04X vs x%04X\n",
+                program, 0x5EED0000u + program, reference->executed, compiled->executed, reference->pc, compiled->pc);
+            failures++;
+        }
+    }
+
+    verbosity = savedVerbosity;
+    printf("JIT self-check: %d programs, %lld instructions, %lld blocks compiled, %lld dropped, %d mismatches\n",
+        programCount, instructions, compiledBlocks, droppedBlocks, failures);
+
+    fclose(input);
+    fclose(referenceOutput);
+    fclose(compiledOutput);
+    free(jit);
+    free(compiled);
+    free(reference);
+    free(image);
+    return failures == 0;
+}
+
+// The engine's listing, or its diagnostics, as one string
+char *renderAssemblyEngine(const AssemblyEngine *engine, bool diagnostics, size_t *length)
+{
+    char *text = NULL;
+    FILE *file = open_memstream(&text, length);
+    if (file == NULL)
+    {
+        fprintf(stderr, "Memory allocation failed.\n");
+        exit(EXIT_FAILURE);
+    }
+    if (diagnostics)
+    {
+        writeAssemblyEngineDiagnostics(engine, file);
+    }
+    else
+    {
+        OutputWriter writer;
+        initOutputWriter(&writer, file, FORMAT_LISTING);
+        writeAssemblyEngine(engine, &writer);
+        freeOutputWriter(&writer);
+    }
+    fclose(file);
+    return text;
+}
+
+bool sameRendering(const AssemblyEngine *a, const AssemblyEngine *b, bool diagnostics)
+{
+    size_t lengthA;
+    size_t lengthB;
+    char *textA = renderAssemblyEngine(a, diagnostics, &lengthA);
+    char *textB = renderAssemblyEngine(b, diagnostics, &lengthB);
+    bool same = lengthA == lengthB && memcmp(textA, textB, lengthA) == 0;
+    free(textA);
+    free(textB);
+    return same;
+}
+
+/*
+    Differential test of the incremental engine. The source is first
+    loaded whole and its listing compared with assembleFile's. Then random
+    edits (deleting lines, pasting lines from elsewhere in the file,
+    adding labels, resending a range unchanged) go to the engine one at a
+    time, and after each one it must match a fresh engine loaded with the
+    whole edited text: same listing, same diagnostics, same error count.
+*/
+bool runIncrementalSelfCheck(const char *path, int editCount)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Error opening file %s!\n", path);
+        return false;
+    }
+    Arena arena;
+    initArena(&arena);
+    size_t sourceLength;
+    const char *source = arenaReadFile(&arena, file, &sourceLength);
+    fclose(file);
+
+    Verbosity savedVerbosity = verbosity;
+    verbosity = VERBOSITY_ERRORS;
+    int failures = 0;
+
+    AssemblyEngine engine;
+    initAssemblyEngine(&engine);
+    loadAssemblyEngine(&engine, source, sourceLength);
+    double loadMilliseconds = engine.milliseconds;
+
+    // The engine against the regular assembler, through a scratch file
+    char outputPath[] = "/tmp/lc3-incremental-XXXXXX";
+    int descriptor = mkstemp(outputPath);
+    if (descriptor >= 0)
+    {
+        close(descriptor);
+        AssemblyJob job = { path, outputPath, FORMAT_LISTING, false, NULL, SYMBOLS_NONE, NULL, 0 };
+        FILE *savedLogStream = logStream;
+        int savedErrorCount = errorCount;
+        logStream = fopen("/dev/null", "w");
+        bool assembled = logStream != NULL && assembleFile(&job);
+        if (logStream != NULL)
+        {
+            fclose(logStream);
+        }
+        logStream = savedLogStream;
+        errorCount = savedErrorCount;
+
+        FILE *expected = fopen(outputPath, "r");
+        size_t expectedLength = 0;
+        const char *expectedText = expected != NULL ? arenaReadFile(&arena, expected, &expectedLength) : NULL;
+        if (expected != NULL)
+        {
+            fclose(expected);
+        }
+        size_t actualLength;
+        char *actualText = renderAssemblyEngine(&engine, false, &actualLength);
+        if (!assembled || expectedText == NULL || expectedLength != actualLength || memcmp(expectedText, actualText, actualLength) != 0
+            || job.errors != engineErrors(&engine))
+        {
+            printf("Incremental mismatch: the engine's listing of %s differs from assembleFile's\n", path);
+            failures++;
+        }
+        free(actualText);
+        remove(outputPath);
+    }
+
+    // Edits draw their text from the file's own lines
+    int poolCount = 0;
+    TokenView *pool = (TokenView *)malloc((engine.lineCount > 0 ? engine.lineCount : 1) * sizeof(TokenView));
+    if (!pool)
+    {
+        fprintf(stderr, "Memory allocation failed.\n");
+        exit(EXIT_FAILURE);
+    }
+    int i;
+    for (i = 0; i < engine.lineCount; i++)
+    {
+        pool[poolCount].start = arenaStrndup(&arena, engine.lines[i].text, engine.lines[i].length);
+        pool[poolCount].length = engine.lines[i].length;
+        poolCount++;
+    }
+
+    unsigned int seed = 0x1AC3u;
+    long long relexed = 0;
+    long long reassembled = 0;
+    double totalMilliseconds = 0;
+    double worstMilliseconds = 0;
+    double freshMilliseconds = 0;
+    char generated[64];
+    int edit;
+    for (edit = 0; edit < editCount && poolCount > 0; edit++)
+    {
+        int lineCount = engine.lineCount;
+        int firstLine = (int)(nextRandom(&seed) % (lineCount + 1));
+        int removedLines = 0;
+        TokenView added[3];
+        int addedLines = 0;
+        switch (nextRandom(&seed) % 6)
+        {
+            case 0: // Delete a few lines
+                removedLines = 1 + nextRandom(&seed) % 3;
+                break;
+            case 1: // Paste a few lines from anywhere in the file
+                addedLines = 1 + nextRandom(&seed) % 3;
+                for (i = 0; i < addedLines; i++)
+                {
+                    added[i] = pool[nextRandom(&seed) % poolCount];
+                }
+                break;
+            case 2: // Overwrite one line
+                removedLines = 1;
+                addedLines = 1;
+                added[0] = pool[nextRandom(&seed) % poolCount];
+                break;
+            case 3: // A new label, possibly one that is already taken
+                sprintf(generated, "E%u .FILL #%u\n", nextRandom(&seed) % 32, nextRandom(&seed) % 100);
+                added[0].start = generated;
+                added[0].length = strlen(generated);
+                addedLines = 1;
+                break;
+            case 4: // Grow or shrink the program in the middle
+                sprintf(generated, "        .BLKW %u\n", 1 + nextRandom(&seed) % 300);
+                added[0].start = generated;
+                added[0].length = strlen(generated);
+                addedLines = 1;
+                break;
+            default: // Resend lines that did not change
+                removedLines = 1 + nextRandom(&seed) % 3;
+                for (i = 0; i < removedLines && firstLine + i < lineCount; i++)
+                {
+                    added[addedLines].start = engine.lines[firstLine + i].text;
+                    added[addedLines].length = engine.lines[firstLine + i].length;
+                    addedLines++;
+                }
+                break;
+        }
+        if (removedLines > lineCount - firstLine)
+        {
+            removedLines = lineCount - firstLine;
+        }
+
+        size_t textLength = 0;
+        for (i = 0; i < addedLines; i++)
+        {
+            textLength += added[i].length;
+        }
+        // Room for a newline after every added line
+        char *text = (char *)malloc(textLength + addedLines + 1);
+        if (!text)
+        {
+            fprintf(stderr, "Memory allocation failed.\n");
+            exit(EXIT_FAILURE);
+        }
+        textLength = 0;
+        for (i = 0; i < addedLines; i++)
+        {
+            memcpy(text + textLength, added[i].start, added[i].length);
+            textLength += added[i].length;
+            if (text[textLength - 1] != '\n')
+            {
+                text[textLength++] = '\n'; // Only the file's last line can lack one
+            }
+        }
+
+        editAssemblyEngine(&engine, firstLine, removedLines, text, textLength);
+        free(text);
+        relexed += engine.relexedLines;
+        reassembled += engine.reassembledLines;
+        totalMilliseconds += engine.milliseconds;
+        if (engine.milliseconds > worstMilliseconds)
+        {
+            worstMilliseconds = engine.milliseconds;
+        }
+
+        // The reference is everything assembled from scratch
+        size_t wholeLength = 0;
+        for (i = 0; i < engine.lineCount; i++)
+        {
+            wholeLength += engine.lines[i].length;
+        }
+        char *whole = (char *)malloc(wholeLength + 1);
+        if (!whole)
+        {
+            fprintf(stderr, "Memory allocation failed.\n");
+            exit(EXIT_FAILURE);
+        }
+        wholeLength = 0;
+        for (i = 0; i < engine.lineCount; i++)
+        {
+            memcpy(whole + wholeLength, engine.lines[i].text, engine.lines[i].length);
+            wholeLength += engine.lines[i].length;
+        }
+
+        AssemblyEngine fresh;
+        initAssemblyEngine(&fresh);
+        loadAssemblyEngine(&fresh, whole, wholeLength);
+        freshMilliseconds += fresh.milliseconds;
+        free(whole);
+
+        if (fresh.lineCount != engine.lineCount || engineErrors(&fresh) != engineErrors(&engine)
+            || !sameRendering(&fresh, &engine, false) || !sameRendering(&fresh, &engine, true))
+        {
+            if (failures < 10)
+            {
+                printf("Incremental mismatch after edit %d (lines %d, removed %d, added %d)\n", edit, firstLine, removedLines, addedLines);
+            }
+            failures++;
+        }
+        freeAssemblyEngine(&fresh);
+    }
+
+    verbosity = savedVerbosity;
+    printf("Incremental self-check: %d lines, %d edits, %d mismatches\n", engine.lineCount, edit, failures);
+    if (edit > 0)
+    {
+        printf("  per edit: %.1f lines relexed, %.1f re-encoded, %.3f ms mean, %.3f ms worst\n",
+            (double)relexed / edit, (double)reassembled / edit, totalMilliseconds / edit, worstMilliseconds);
+        printf("  whole file: %.3f ms to load, %.3f ms mean to reassemble after an edit\n", loadMilliseconds, freshMilliseconds / edit);
+    }
+
+    free(pool);
+    freeAssemblyEngine(&engine);
+    freeArena(&arena);
+    return failures == 0;
+}
+
+
+/*
+    Disassembles random objects and assembles the listings again, which
+    must give back the same object file. Most words are PC-relative
+    instructions, with offsets that land inside the image, right outside
+    it or anywhere. The rest are random words and runs of zeros.
+*/
+bool runDisassemblerSelfCheck(int objectCount)
+{
+    static const uint16_t pcRelativeOpcodes[] = { 0x0E00, 0x0400, 0x2000, 0x3000, 0x4800, 0xA000, 0xB000, 0xE000 }; // BRnzp, BRz, LD, ST, JSR, LDI, STI, LEA
+    char objectPath[] = "/tmp/lc3-disassembly-XXXXXX";
+    char listingPath[] = "/tmp/lc3-disassembly-XXXXXX";
+    int objectDescriptor = mkstemp(objectPath);
+    int listingDescriptor = mkstemp(listingPath);
+    if (objectDescriptor < 0 || listingDescriptor < 0)
+    {
+        fprintf(stderr, "Error creating scratch files.\n");
+        return false;
+    }
+    close(objectDescriptor);
+    close(listingDescriptor);
+
+    unsigned char *object = (unsigned char *)malloc(2 + 2 * 512);
+    AssemblyOutput output;
+    if (!object || !initAssemblyOutput(&output))
+    {
+        fprintf(stderr, "Memory allocation failed.\n");
+        exit(EXIT_FAILURE);
+    }
+    AssemblyOptions options = { FORMAT_OBJECT, false, VERBOSITY_QUIET, NULL };
+    Verbosity savedVerbosity = verbosity;
+    verbosity = VERBOSITY_QUIET;
+
+    Arena arena;
+    initArena(&arena);
+    unsigned int seed = 0xD15Au;
+    int failures = 0;
+    int outsideTargets = 0;
+    int i;
+    for (i = 0; i < objectCount; i++)
+    {
+        int origin = nextRandom(&seed) & 0xFFFF;
+        int wordCount = 1 + nextRandom(&seed) % 512;
+        storeBigEndian(object, (uint32_t)origin, 2);
+        int j;
+        for (j = 0; j < wordCount; j++)
+        {
+            uint16_t word;
+            unsigned int kind = nextRandom(&seed) % 10;
+            if (kind < 6)
+            {
+                int opcode = pcRelativeOpcodes[nextRandom(&seed) % 8];
+                int bits = opcode == 0x4800 ? 11 : 9;
+                int offset;
+                switch (nextRandom(&seed) % 3)
+                {
+                    case 0:
+                        offset = (int)(nextRandom(&seed) % wordCount) - j - 1; // Inside the image
+                        break;
+                    case 1:
+                        offset = wordCount - j + (int)(nextRandom(&seed) % 4); // Just past the end
+                        break;
+                    default:
+                        offset = (int)nextRandom(&seed); // Anywhere
+                        break;
+                }
+                if (!fitsInBits(offset, bits))
+                {
+                    offset = signExtend((uint16_t)offset, bits);
+                }
+                int target = (origin + j + 1 + offset) & 0xFFFF;
+                if (((target - origin) & 0xFFFF) >= wordCount)
+                {
+                    outsideTargets++;
+                }
+                word = (uint16_t)(opcode | (bits == 9 ? (nextRandom(&seed) & 7) << 9 : 0) | (offset & ((1 << bits) - 1)));
+            }
+            else if (kind < 8)
+            {
+                word = (uint16_t)nextRandom(&seed);
+            }
+            else
+            {
+                word = 0;
+            }
+            storeBigEndian(object + 2 + j * 2, word, 2);
+        }
+
+        size_t objectLength = 2 + (size_t)wordCount * 2;
+        size_t listingLength = 0;
+        const char *listing = NULL;
+        arenaReset(&arena);
+        if (writeWholeFile(objectPath, (const char *)object, objectLength) && disassembleFile(objectPath, NULL, listingPath))
+        {
+            listing = readWholeFile(&arena, listingPath, &listingLength);
+        }
+        bool assembled = listing != NULL && assemble(listing, listingLength, options, &output);
+        if (!assembled || output.length != objectLength || memcmp(output.bytes, object, objectLength) != 0)
+        {
+            if (failures < 10)
+            {
+                printf("Disassembly mismatch: object %d (origin x%04X, %d words) does not assemble back\n", i, origin, wordCount);
+            }
+            failures++;
+        }
+    }
+
+    verbosity = savedVerbosity;
+    printf("Disassembler self-check: %d objects, %d targets outside the image, %d mismatches\n", objectCount, outsideTargets, failures);
+
+    remove(objectPath);
+    remove(listingPath);
+    freeArena(&arena);
+    freeAssemblyOutput(&output);
+    free(object);
+    return failures == 0;
+}
+
+/*
+    Writes random symbol tables as .lsym files, loads each one back and
+    resolves every label's address through findSymbolAtAddress, plus
+    random addresses that mostly miss, comparing each answer with a
+    linear scan of the records.
+*/
+bool runSymbolIndexSelfCheck(int tableCount)
+{
+    char tablePath[] = "/tmp/lc3-symbols-XXXXXX";
+    int tableDescriptor = mkstemp(tablePath);
+    if (tableDescriptor < 0)
+    {
+        fprintf(stderr, "Error creating scratch files.\n");
+        return false;
+    }
+    close(tableDescriptor);
+
+    Arena names;
+    initArena(&names);
+    SymbolTable symbols;
+    initSymbolTable(&symbols, &names);
+
+    unsigned int seed = 0x5EEDu;
+    int failures = 0;
+    int lookups = 0;
+    int misses = 0;
+    int i;
+    for (i = 0; i < tableCount; i++)
+    {
+        clearSymbolTable(&symbols);
+        arenaReset(&names);
+        int labelCount = (int)(nextRandom(&seed) % 300);
+        int base = nextRandom(&seed) & 0xFFFF;
+        int j;
+        for (j = 0; j < labelCount; j++)
+        {
+            char label[16];
+            int length = snprintf(label, sizeof(label), "L%d", j);
+            // Mostly clustered like a real program, sometimes sharing an address or anywhere at all
+            int address = nextRandom(&seed) % 8 == 0 ? (int)(nextRandom(&seed) & 0xFFFF) : (base + (int)(nextRandom(&seed) % 1024)) & 0xFFFF;
+            addLabel(&symbols, label, (size_t)length, j + 1, address);
+        }
+
+        const LabelInfo **sorted = sortSymbolsByAddress(&symbols);
+        bool written = writeSymbolTableFile(sorted, symbols.count, tablePath);
+        free(sorted);
+        SymbolIndex index;
+        if (!written || !loadSymbolIndex(tablePath, &index) || index.count != symbols.count)
+        {
+            if (failures < 10)
+            {
+                printf("Symbol index mismatch: table %d (%d labels) does not load back\n", i, labelCount);
+            }
+            if (written && index.data != NULL)
+            {
+                freeSymbolIndex(&index);
+            }
+            failures++;
+            continue;
+        }
+
+        // Every label, then as many random addresses
+        for (j = 0; j < 2 * symbols.count + 16; j++)
+        {
+            uint16_t address = j < symbols.count ? (uint16_t)symbols.entries[j].address : (uint16_t)nextRandom(&seed);
+            int expected = -1;
+            int k;
+            for (k = 0; k < index.count && symbolIndexAddress(&index, k) <= address; k++)
+            {
+                expected = k;
+            }
+            int found = findSymbolAtAddress(&index, address);
+            bool named = true;
+            if (j < symbols.count)
+            {
+                // The label itself is one of the records at its address
+                named = false;
+                for (k = found; k >= 0 && symbolIndexAddress(&index, k) == address; k--)
+                {
+                    named = named || strcmp(symbolIndexName(&index, k), symbols.entries[j].label) == 0;
+                }
+            }
+            else if (expected < 0 || symbolIndexAddress(&index, expected) != address)
+            {
+                misses++;
+            }
+            lookups++;
+            if (found != expected || !named)
+            {
+                if (failures < 10)
+                {
+                    printf("Symbol index mismatch: table %d, x%04X found record %d, expected %d\n", i, address, found, expected);
+                }
+                failures++;
+            }
+        }
+        freeSymbolIndex(&index);
+    }
+
+    printf("Symbol index self-check: %d tables, %d lookups, %d misses, %d mismatches\n", tableCount, lookups, misses, failures);
+
+    remove(tablePath);
+    freeSymbolTable(&symbols);
+    freeArena(&names);
+    return failures == 0;
+}
+
+#endif
@@ -0,0 +1,514 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <utime.h>
+#include <sys/stat.h>
+
+#define CACHE_ENTRY_MAGIC "LC3C"
+#define CACHE_ENTRY_VERSION 1
+#define CACHE_HEADER_SIZE 40
+#define CACHE_ENTRY_EXTENSION ".lc3c"
+
+/*
+    Anything a cached entry was produced under that can change the bytes it
+    holds. The build time stands in for the assembler version, so a rebuilt
+    assembler never serves output from an older one; define
+    LC3_ASSEMBLER_VERSION to share a cache between builds.
+*/
+#ifndef LC3_ASSEMBLER_VERSION
+#define LC3_ASSEMBLER_VERSION __DATE__ " " __TIME__
+#endif
+
+/*
+    Eight bytes at a time: multiply, fold the high half back in. Not
+    cryptographic, only meant to tell sources apart quickly.
+*/
+uint64_t hashBytes64(const void *data, size_t length, uint64_t seed)
+{
+    const uint64_t multiplier = 0x9E3779B97F4A7C15ULL;
+    const unsigned char *bytes = (const unsigned char *)data;
+    uint64_t hash = seed ^ (length * multiplier);
+
+    while (length >= 8)
+    {
+        uint64_t word;
+        memcpy(&word, bytes, sizeof(word));
+        hash = (hash ^ word) * multiplier;
+        hash ^= hash >> 29;
+        bytes += 8;
+        length -= 8;
+    }
+
+    uint64_t tail = 0;
+    memcpy(&tail, bytes, length);
+    hash = (hash ^ tail) * multiplier;
+    hash ^= hash >> 32;
+    hash *= multiplier;
+    hash ^= hash >> 29;
+    return hash;
+}
+
+char *cacheEntryPath(const AssemblyCache *cache, uint64_t key)
+{
+    char *path = (char *)malloc(strlen(cache->directory) + 1 + 16 + strlen(CACHE_ENTRY_EXTENSION) + 1);
+    if (!path)
+    {
+        fprintf(stderr, "Memory allocation failed.\n");
+        exit(EXIT_FAILURE);
+    }
+    sprintf(path, "%s/%016llx%s", cache->directory, (unsigned long long)key, CACHE_ENTRY_EXTENSION);
+    return path;
+}
+
+bool isCacheEntryName(const char *name)
+{
+    size_t length = strlen(name);
+    size_t extension = strlen(CACHE_ENTRY_EXTENSION);
+    return name[0] != '.' && length > extension && strcmp(name + length - extension, CACHE_ENTRY_EXTENSION) == 0;
+}
+
+/*
+    Totals the entries in the directory and, when limit is not negative,
+    deletes the least recently used ones until the total is at most limit.
+    Hits touch an entry's modification time, so that is the use order.
+*/
+long long pruneCacheDirectory(AssemblyCache *cache, long long limit)
+{
+    DIR *directory = opendir(cache->directory);
+    if (directory == NULL)
+    {
+        return 0;
+    }
+
+    CachedFile *files = NULL;
+    int count = 0;
+    int capacity = 0;
+    long long total = 0;
+    size_t directoryLength = strlen(cache->directory);
+
+    struct dirent *entry;
+    while ((entry = readdir(directory)) != NULL)
+    {
+        if (!isCacheEntryName(entry->d_name))
+        {
+            continue;
+        }
+
+        char *path = (char *)malloc(directoryLength + strlen(entry->d_name) + 2);
+        if (!path)
+        {
+            fprintf(stderr, "Memory allocation failed.\n");
+            exit(EXIT_FAILURE);
+        }
+        sprintf(path, "%s/%s", cache->directory, entry->d_name);
+
+        struct stat info;
+        if (stat(path, &info) != 0 || !S_ISREG(info.st_mode))
+        {
+            free(path);
+            continue;
+        }
+
+        if (count == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 64;
+            CachedFile *grown = (CachedFile *)realloc(files, capacity * sizeof(CachedFile));
+            if (!grown)
+            {
+                fprintf(stderr, "Memory allocation failed.\n");
+                exit(EXIT_FAILURE);
+            }
+            files = grown;
+        }
+        files[count].path = path;
+        files[count].size = (long long)info.st_size;
+        files[count].lastUsed = (long long)info.st_mtime;
+        count++;
+        total += (long long)info.st_size;
+    }
+    closedir(directory);
+
+    if (limit >= 0 && total > limit)
+    {
+        qsort(files, count, sizeof(CachedFile), compareCachedFiles);
+        int i;
+        for (i = 0; i < count && total > limit; i++)
+        {
+            if (unlink(files[i].path) == 0)
+            {
+                total -= files[i].size;
+                cache->evictions++;
+            }
+        }
+    }
+
+    int i;
+    for (i = 0; i < count; i++)
+    {
+        free(files[i].path);
+    }
+    free(files);
+    return total;
+}
+
+// Oldest first, then by name so the order does not depend on the directory listing
+int compareCachedFiles(const void *a, const void *b)
+{
+    const CachedFile *left = (const CachedFile *)a;
+    const CachedFile *right = (const CachedFile *)b;
+    if (left->lastUsed != right->lastUsed)
+    {
+        return left->lastUsed < right->lastUsed ? -1 : 1;
+    }
+    return strcmp(left->path, right->path);
+}
+
+// Creates the directory if needed; false when it cannot be used
+bool initAssemblyCache(AssemblyCache *cache, const char *directory, long long sizeLimit)
+{
+    cache->directory = directory;
+    cache->sizeLimit = sizeLimit;
+    cache->hits = 0;
+    cache->misses = 0;
+    cache->stores = 0;
+    cache->evictions = 0;
+
+    // Read once here, before any worker starts: umask can only be read by setting it
+    mode_t mask = umask(0);
+    umask(mask);
+    cache->entryMode = 0666 & ~mask;
+
+    struct stat info;
+    if (mkdir(directory, 0777) != 0 && (stat(directory, &info) != 0 || !S_ISDIR(info.st_mode)))
+    {
+        return false;
+    }
+
+    pthread_mutex_init(&cache->lock, NULL);
+    // A smaller limit than last time takes effect straight away
+    cache->size = pruneCacheDirectory(cache, sizeLimit);
+    return true;
+}
+
+void freeAssemblyCache(AssemblyCache *cache)
+{
+    pthread_mutex_destroy(&cache->lock);
+}
+
+void reportAssemblyCache(const AssemblyCache *cache)
+{
+    LOG_TRACE("Cache %s: %d hits, %d misses, %d stored, %d evicted, %lld bytes.\n", cache->directory, cache->hits, cache->misses, cache->stores, cache->evictions, cache->size);
+}
+
+/*
+    The key covers the source bytes and every setting that changes what
+    assembling them produces, including how much gets logged. The output
+    path is not in it: nothing written depends on it.
+*/
+uint64_t cacheKeyFor(const AssemblyJob *job, const char *source, size_t sourceLength)
+{
+    char settings[128];
+    int length = snprintf(settings, sizeof(settings), "%s/%d/%d/%d/%d/%d", LC3_ASSEMBLER_VERSION, (int)job->format, (int)job->singlePass, job->symbolExport, (int)verbosity, LC3_MAX_VERBOSITY);
+    uint64_t seed = hashBytes64(settings, (size_t)length, 0);
+    return hashBytes64(source, sourceLength, seed);
+}
+
+// Writes length bytes to path, replacing whatever is there
+bool writeWholeFile(const char *path, const char *data, size_t length)
+{
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+    {
+        return false;
+    }
+    bool written = fwrite(data, 1, length, file) == length;
+    return fclose(file) == 0 && written;
+}
+
+// Null when the file cannot be read; the contents live in the arena
+const char *readWholeFile(Arena *arena, const char *path, size_t *length)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        return NULL;
+    }
+    const char *contents = arenaReadFile(arena, file, length);
+    fclose(file);
+    return contents;
+}
+
+/*
+    An entry is one file: a 40-byte big-endian header (LC3C, version,
+    errors, source length, the lengths of the four sections, then the key),
+    followed by the output, the .lsym table, the .sym text and the
+    diagnostics. A hit maps it and writes each section straight out of the
+    mapping, so the source is never lexed.
+*/
+bool loadCachedAssembly(AssemblyCache *cache, AssemblyJob *job, uint64_t key, size_t sourceLength)
+{
+    char *path = cacheEntryPath(cache, key);
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        free(path);
+        return false;
+    }
+
+    size_t entryLength;
+    const char *entry = mapInputFile(file, &entryLength);
+    fclose(file);
+    if (entry == NULL)
+    {
+        free(path);
+        return false;
+    }
+
+    const unsigned char *header = (const unsigned char *)entry;
+    uint32_t sections[4];
+    size_t expected = CACHE_HEADER_SIZE;
+    int i;
+    bool valid = entryLength >= CACHE_HEADER_SIZE
+        && memcmp(header, CACHE_ENTRY_MAGIC, 4) == 0
+        && loadBigEndian(header + 4, 4) == CACHE_ENTRY_VERSION
+        && loadBigEndian(header + 12, 4) == (uint32_t)sourceLength
+        && loadBigEndian(header + 32, 4) == (uint32_t)(key >> 32)
+        && loadBigEndian(header + 36, 4) == (uint32_t)key;
+    for (i = 0; valid && i < 4; i++)
+    {
+        sections[i] = loadBigEndian(header + 16 + i * 4, 4);
+        expected += sections[i];
+    }
+    if (!valid || expected != entryLength)
+    {
+        unmapInputFile(entry, entryLength);
+        free(path);
+        return false;
+    }
+
+    const char *output = entry + CACHE_HEADER_SIZE;
+    const char *table = output + sections[0];
+    const char *text = table + sections[1];
+    const char *diagnostics = text + sections[2];
+
+    bool written = writeWholeFile(job->outputPath, output, sections[0]);
+    if (written && (job->symbolExport & SYMBOLS_TABLE))
+    {
+        char *symbolPath = symbolPathFor(job->outputPath, ".lsym");
+        written = writeWholeFile(symbolPath, table, sections[1]);
+        free(symbolPath);
+    }
+    if (written && (job->symbolExport & SYMBOLS_TEXT))
+    {
+        char *symbolPath = symbolPathFor(job->outputPath, ".sym");
+        written = writeWholeFile(symbolPath, text, sections[2]);
+        free(symbolPath);
+    }
+
+    if (written)
+    {
+        fwrite(diagnostics, 1, sections[3], logStream);
+        job->errors = (int)loadBigEndian(header + 8, 4);
+        errorCount = job->errors;
+        // Marks the entry as just used for the eviction order
+        utime(path, NULL);
+    }
+
+    unmapInputFile(entry, entryLength);
+    free(path);
+    return written;
+}
+
+/*
+    Reads back what assembling wrote and files it under key. The entry is
+    written to a temporary name and renamed into place, so a reader never
+    sees half of one and jobs racing on the same source just replace it.
+*/
+void storeCachedAssembly(AssemblyCache *cache, const AssemblyJob *job, uint64_t key, size_t sourceLength, const char *diagnostics, size_t diagnosticsLength)
+{
+    Arena arena;
+    initArena(&arena);
+
+    const char *sections[4] = { NULL, "", "", diagnostics };
+    size_t lengths[4] = { 0, 0, 0, diagnosticsLength };
+    sections[0] = readWholeFile(&arena, job->outputPath, &lengths[0]);
+    bool complete = sections[0] != NULL;
+    if (complete && (job->symbolExport & SYMBOLS_TABLE))
+    {
+        char *symbolPath = symbolPathFor(job->outputPath, ".lsym");
+        sections[1] = readWholeFile(&arena, symbolPath, &lengths[1]);
+        complete = sections[1] != NULL;
+        free(symbolPath);
+    }
+    if (complete && (job->symbolExport & SYMBOLS_TEXT))
+    {
+        char *symbolPath = symbolPathFor(job->outputPath, ".sym");
+        sections[2] = readWholeFile(&arena, symbolPath, &lengths[2]);
+        complete = sections[2] != NULL;
+        free(symbolPath);
+    }
+    if (!complete)
+    {
+        freeArena(&arena);
+        return;
+    }
+
+    unsigned char header[CACHE_HEADER_SIZE];
+    memcpy(header, CACHE_ENTRY_MAGIC, 4);
+    storeBigEndian(header + 4, CACHE_ENTRY_VERSION, 4);
+    storeBigEndian(header + 8, (uint32_t)job->errors, 4);
+    storeBigEndian(header + 12, (uint32_t)sourceLength, 4);
+    long long entryLength = CACHE_HEADER_SIZE;
+    int i;
+    for (i = 0; i < 4; i++)
+    {
+        storeBigEndian(header + 16 + i * 4, (uint32_t)lengths[i], 4);
+        entryLength += (long long)lengths[i];
+    }
+    storeBigEndian(header + 32, (uint32_t)(key >> 32), 4);
+    storeBigEndian(header + 36, (uint32_t)key, 4);
+    if (entryLength > cache->sizeLimit || lengths[0] > UINT32_MAX || lengths[3] > UINT32_MAX)
+    {
+        // It would only push everything else out, or its lengths do not fit the header
+        freeArena(&arena);
+        return;
+    }
+
+    char *path = cacheEntryPath(cache, key);
+    char *temporaryPath = (char *)malloc(strlen(cache->directory) + 32);
+    if (!temporaryPath)
+    {
+        fprintf(stderr, "Memory allocation failed.\n");
+        exit(EXIT_FAILURE);
+    }
+    // The leading dot keeps it out of the directory scans
+    sprintf(temporaryPath, "%s/.%016llx.XXXXXX", cache->directory, (unsigned long long)key);
+
+    int fd = mkstemp(temporaryPath);
+    if (fd >= 0)
+    {
+        // Readable by whoever else shares the directory, as a plain open would have made it
+        fchmod(fd, cache->entryMode);
+    }
+    FILE *file = fd >= 0 ? fdopen(fd, "wb") : NULL;
+    bool written = file != NULL && fwrite(header, 1, sizeof(header), file) == sizeof(header);
+    for (i = 0; written && i < 4; i++)
+    {
+        written = fwrite(sections[i], 1, lengths[i], file) == lengths[i];
+    }
+    if (file != NULL)
+    {
+        written = fclose(file) == 0 && written;
+    }
+    else if (fd >= 0)
+    {
+        close(fd);
+    }
+
+    if (fd >= 0 && (!written || rename(temporaryPath, path) != 0))
+    {
+        unlink(temporaryPath);
+        written = false;
+    }
+
+    if (written)
+    {
+        pthread_mutex_lock(&cache->lock);
+        cache->stores++;
+        cache->size += entryLength;
+        if (cache->size > cache->sizeLimit)
+        {
+            // Down to three quarters, so the next few stores do not each trigger a scan
+            cache->size = pruneCacheDirectory(cache, cache->sizeLimit / 4 * 3);
+        }
+        pthread_mutex_unlock(&cache->lock);
+    }
+
+    free(temporaryPath);
+    free(path);
+    freeArena(&arena);
+}
+
+/*
+    assembleFile behind the cache. Only named files are cached: stdin has
+    no stable contents to key on, stdout cannot be replayed into, and a job
+    that also fills a memory image needs the passes to run.
+*/
+bool assembleJob(AssemblyJob *job)
+{
+    AssemblyCache *cache = job->cache;
+    if (cache == NULL || job->image != NULL || strcmp(job->inputPath, "-") == 0 || strcmp(job->outputPath, "-") == 0)
+    {
+        return assembleFile(job);
+    }
+
+    FILE *file = fopen(job->inputPath, "r");
+    if (file == NULL)
+    {
+        // Let assembleFile report it
+        return assembleFile(job);
+    }
+
+    Arena arena;
+    initArena(&arena);
+    size_t sourceLength;
+    const char *mappedSource = mapInputFile(file, &sourceLength);
+    const char *source = mappedSource != NULL ? mappedSource : arenaReadFile(&arena, file, &sourceLength);
+    uint64_t key = cacheKeyFor(job, source, sourceLength);
+    if (mappedSource != NULL)
+    {
+        unmapInputFile(mappedSource, sourceLength);
+    }
+    fclose(file);
+    freeArena(&arena);
+
+    bool hit = sourceLength <= UINT32_MAX && loadCachedAssembly(cache, job, key, sourceLength);
+    pthread_mutex_lock(&cache->lock);
+    if (hit)
+    {
+        cache->hits++;
+    }
+    else
+    {
+        cache->misses++;
+    }
+    pthread_mutex_unlock(&cache->lock);
+    if (hit)
+    {
+        return true;
+    }
+
+    // The diagnostics go into the entry as well as wherever they were headed
+    FILE *log = logStream;
+    char *captured = NULL;
+    size_t capturedLength = 0;
+    logStream = open_memstream(&captured, &capturedLength);
+    if (logStream == NULL)
+    {
+        logStream = log;
+        return assembleFile(job);
+    }
+
+    bool assembled = assembleFile(job);
+
+    fclose(logStream);
+    logStream = log;
+    fwrite(captured, 1, capturedLength, logStream);
+
+    if (assembled && sourceLength <= UINT32_MAX)
+    {
+        storeCachedAssembly(cache, job, key, sourceLength, captured, capturedLength);
+    }
+    free(captured);
+    return assembled;
+}
+
+#endif
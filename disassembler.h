@@ -0,0 +1,641 @@
+#ifndef DISASSEMBLER_H
+#define DISASSEMBLER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <ctype.h>
+
+#define DISASSEMBLY_BUFFER_SIZE (64 * 1024)
+#define DISASSEMBLY_MAX_LABEL 200 // Longer names are cut short so a line always fits in the buffer's slack
+#define DISASSEMBLY_LINE_SLACK (2 * DISASSEMBLY_MAX_LABEL + 112)
+
+// instructionMap read backwards: the opcode bits pick the rows, bit 5, bit 11 or BaseR tell apart the rows that share an opcode
+BinOps binOpForWord(uint16_t word)
+{
+    uint16_t opcodeBits = word >> 12;
+    int i;
+    for (i = 0; i < INVALID_OP; i++)
+    {
+        if (instructionMap[i].opcodeBits != opcodeBits)
+        {
+            continue;
+        }
+        switch (instructionMap[i].binaryOps)
+        {
+            case ADD_ONE_OP:
+            case AND_ONE_OP:
+                if (word & 0x20) continue;
+                break;
+            case ADD_TWO_OP:
+            case AND_TWO_OP:
+                if (!(word & 0x20)) continue;
+                break;
+            case JMP_OP:
+                if (((word >> 6) & 0x7) == R7) continue;
+                break;
+            case RET_OP:
+                if (((word >> 6) & 0x7) != R7) continue;
+                break;
+            case JSR_OP:
+                if (!(word & 0x800)) continue;
+                break;
+            case JSRR_OP:
+                if (word & 0x800) continue;
+                break;
+            default:
+                break;
+        }
+        return instructionMap[i].binaryOps;
+    }
+    return INVALID_OP;
+}
+
+// The assembler's own descriptor for an encoding, a TRAP alias when the vector has one
+const InstructionDescriptor *descriptorForBinOp(BinOps binaryOps, int trapVector)
+{
+    const int count = sizeof(instructionDescriptors) / sizeof(instructionDescriptors[0]);
+    const InstructionDescriptor *found = NULL;
+    int i;
+    for (i = 0; i < count; i++)
+    {
+        const InstructionDescriptor *descriptor = &instructionDescriptors[i];
+        if (descriptor->registerForm != binaryOps && descriptor->immediateForm != binaryOps)
+        {
+            continue;
+        }
+        if (binaryOps == TRAP_OP && descriptor->shape == SHAPE_NONE)
+        {
+            if (descriptor->impliedImmediate == trapVector)
+            {
+                return descriptor;
+            }
+            continue;
+        }
+        if (found == NULL)
+        {
+            found = descriptor;
+        }
+    }
+    return found;
+}
+
+void appendRegisterName(char *text, int *length, int reg)
+{
+    text[(*length)++] = 'R';
+    text[(*length)++] = (char)('0' + registerMap[reg].regTok);
+}
+
+void appendDecimal(char *text, int *length, int value)
+{
+    char digits[8];
+    int count = 0;
+    unsigned int magnitude = value < 0 ? (unsigned int)-value : (unsigned int)value;
+    if (value < 0)
+    {
+        text[(*length)++] = '-';
+    }
+    do
+    {
+        digits[count++] = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude != 0);
+    while (count > 0)
+    {
+        text[(*length)++] = digits[--count];
+    }
+}
+
+// x followed by exactly digits upper-case hex digits
+void appendHex(char *text, int *length, unsigned int value, int digits)
+{
+    static const char hexDigits[] = "0123456789ABCDEF";
+    text[(*length)++] = 'x';
+    while (digits-- > 0)
+    {
+        text[(*length)++] = hexDigits[(value >> (digits * 4)) & 0xF];
+    }
+}
+
+/*
+    Renders one word the way the assembler would read it back. Bit
+    patterns the assembler cannot produce (reserved bits set, BR with no
+    condition, the reserved opcode) come out as .FILL so the listing
+    reassembles to the same words. PC-relative operands are left off:
+    they depend on the address, so disassembleFile appends them.
+*/
+void buildDisassemblyEntry(const DisassemblyTable *table, uint16_t word, DisassemblyEntry *entry)
+{
+    char *text = entry->text;
+    int length = 0;
+    int dr = (word >> 9) & 0x7;
+    int sr1 = (word >> 6) & 0x7;
+    bool valid = true;
+    entry->targetBits = 0;
+
+    BinOps binaryOps = binOpForWord(word);
+    const InstructionDescriptor *descriptor = binaryOps == TRAP_OP ? table->trapDescriptors[word & 0xFF] : table->descriptors[binaryOps];
+
+    switch (binaryOps)
+    {
+        case ADD_ONE_OP:
+        case AND_ONE_OP:
+            valid = (word & 0x18) == 0;
+            break;
+        case NOT_OP:
+            valid = (word & 0x3F) == 0x3F;
+            break;
+        case BR_OP:
+            valid = dr != 0;
+            break;
+        case JMP_OP:
+        case RET_OP:
+            valid = (word & 0x0E3F) == 0;
+            break;
+        case JSRR_OP:
+            valid = (word & 0x063F) == 0;
+            break;
+        case RTI_OP:
+            valid = (word & 0x0FFF) == 0;
+            break;
+        case TRAP_OP:
+            valid = (word & 0x0F00) == 0;
+            break;
+        case INVALID_OP:
+            valid = false;
+            break;
+        default:
+            break;
+    }
+
+    if (!valid || descriptor == NULL)
+    {
+        memcpy(text, ".FILL #", 7);
+        length = 7;
+        appendDecimal(text, &length, (int16_t)word);
+        text[length] = '\0';
+        entry->length = (uint8_t)length;
+        return;
+    }
+
+    length = (int)strlen(descriptor->mnemonic);
+    memcpy(text, descriptor->mnemonic, length);
+
+    switch (binaryOps)
+    {
+        case ADD_ONE_OP:
+        case AND_ONE_OP:
+        case ADD_TWO_OP:
+        case AND_TWO_OP:
+        case LDR_OP:
+        case STR_OP:
+            text[length++] = ' ';
+            appendRegisterName(text, &length, dr);
+            memcpy(text + length, ", ", 2);
+            length += 2;
+            appendRegisterName(text, &length, sr1);
+            memcpy(text + length, ", ", 2);
+            length += 2;
+            if (binaryOps == ADD_ONE_OP || binaryOps == AND_ONE_OP)
+            {
+                appendRegisterName(text, &length, word & 0x7);
+            }
+            else
+            {
+                text[length++] = '#';
+                appendDecimal(text, &length, signExtend(word, binaryOps == LDR_OP || binaryOps == STR_OP ? 6 : 5));
+            }
+            break;
+        case NOT_OP:
+            text[length++] = ' ';
+            appendRegisterName(text, &length, dr);
+            memcpy(text + length, ", ", 2);
+            length += 2;
+            appendRegisterName(text, &length, sr1);
+            break;
+        case BR_OP:
+            if (dr & CONDITION_N) text[length++] = 'n';
+            if (dr & CONDITION_Z) text[length++] = 'z';
+            if (dr & CONDITION_P) text[length++] = 'p';
+            text[length++] = ' ';
+            entry->targetBits = 9;
+            break;
+        case LD_OP:
+        case LDI_OP:
+        case LEA_OP:
+        case ST_OP:
+        case STI_OP:
+            text[length++] = ' ';
+            appendRegisterName(text, &length, dr);
+            memcpy(text + length, ", ", 2);
+            length += 2;
+            entry->targetBits = 9;
+            break;
+        case JSR_OP:
+            text[length++] = ' ';
+            entry->targetBits = 11;
+            break;
+        case JMP_OP:
+        case JSRR_OP:
+            text[length++] = ' ';
+            appendRegisterName(text, &length, sr1);
+            break;
+        case TRAP_OP:
+            if (descriptor->shape != SHAPE_NONE)
+            {
+                text[length++] = ' ';
+                appendHex(text, &length, word & 0xFF, 2);
+            }
+            break;
+        default:
+            break;
+    }
+
+    text[length] = '\0';
+    entry->length = (uint8_t)length;
+}
+
+// The descriptor searches only depend on the encoding and trap vector, so they are done once up front
+void buildDisassemblyTable(DisassemblyTable *table)
+{
+    int i;
+    for (i = 0; i <= INVALID_OP; i++)
+    {
+        table->descriptors[i] = i == INVALID_OP ? NULL : descriptorForBinOp((BinOps)i, -1);
+    }
+    for (i = 0; i < 256; i++)
+    {
+        table->trapDescriptors[i] = descriptorForBinOp(TRAP_OP, i);
+    }
+
+    int word;
+    for (word = 0; word < LC3_MEMORY_WORDS; word++)
+    {
+        buildDisassemblyEntry(table, (uint16_t)word, &table->entries[word]);
+    }
+}
+
+// Reads an object file: the origin word, then the words loaded from there, all big-endian
+bool readObjectFile(const char *path, MemoryImage *image, int *wordCount)
+{
+    FILE *file = strcmp(path, "-") == 0 ? stdin : fopen(path, "rb");
+    if (file == NULL)
+    {
+        fprintf(logStream, "Error opening file %s!\n", path);
+        return false;
+    }
+
+    // One byte more than the largest object file, to notice anything longer
+    size_t capacity = 2 * (LC3_MEMORY_WORDS + 1) + 1;
+    unsigned char *bytes = (unsigned char *)malloc(capacity);
+    if (!bytes)
+    {
+        fprintf(stderr, "Memory allocation failed.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    initMemoryImage(image);
+    size_t size = fread(bytes, 1, capacity, file);
+    if (file != stdin)
+    {
+        fclose(file);
+    }
+
+    if (size < 2 || size % 2 != 0 || size == capacity)
+    {
+        LOG_ERROR("Error: %s is not an LC-3 object file.\n", path);
+        free(bytes);
+        return false;
+    }
+
+    image->origin = (uint16_t)((bytes[0] << 8) | bytes[1]);
+    image->originSet = true;
+    image->cursor = image->origin;
+    *wordCount = (int)(size / 2 - 1);
+
+    size_t i;
+    for (i = 2; i < size; i += 2)
+    {
+        storeImageWord(image, (uint16_t)((bytes[i] << 8) | bytes[i + 1]));
+    }
+    free(bytes);
+    return true;
+}
+
+/*
+    Reads a text symbol file in the usual LC-3 layout, one "//  NAME  ADDR"
+    row per label under a short header. Any line whose first two fields
+    are a label and a hex address counts, so plain "NAME xADDR" lines work
+    too, and a binary table from exportSymbols is recognized by its magic.
+    The first name seen for an address wins. Returns the number of symbols
+    read, -1 when the file cannot be opened.
+*/
+int readSymbolFile(const char *path, Arena *names, const char **labelAt)
+{
+    int count = 0;
+    SymbolIndex index;
+    if (loadSymbolIndex(path, &index))
+    {
+        int i;
+        for (i = 0; i < index.count; i++)
+        {
+            uint16_t address = symbolIndexAddress(&index, i);
+            if (labelAt[address] == NULL)
+            {
+                const char *name = symbolIndexName(&index, i);
+                labelAt[address] = arenaStrndup(names, name, strlen(name));
+                count++;
+            }
+        }
+        freeSymbolIndex(&index);
+        return count;
+    }
+
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+    {
+        return -1;
+    }
+
+    char line[256];
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        size_t length = strlen(line);
+        size_t cursor = 0;
+        while (cursor < length && (line[cursor] == '/' || isspace((unsigned char)line[cursor])))
+        {
+            cursor++;
+        }
+
+        TokenView name;
+        TokenView address;
+        if (!nextTokenView(line, length, &cursor, &name) || !nextTokenView(line, length, &cursor, &address))
+        {
+            continue;
+        }
+        if (!isalpha((unsigned char)name.start[0]) && name.start[0] != '_')
+        {
+            continue;
+        }
+        if (address.start[0] == 'x' || address.start[0] == 'X')
+        {
+            address.start++;
+            address.length--;
+        }
+
+        size_t i;
+        bool hex = address.length > 0 && address.length <= 4;
+        for (i = 0; hex && i < address.length; i++)
+        {
+            hex = isxdigit((unsigned char)address.start[i]);
+        }
+        if (!hex)
+        {
+            continue;
+        }
+
+        int value = viewToInt(address, 16);
+        if (labelAt[value] == NULL)
+        {
+            labelAt[value] = arenaStrndup(names, name.start, name.length);
+            count++;
+        }
+    }
+
+    fclose(file);
+    return count;
+}
+
+void flushDisassembly(FILE *file, char *buffer, size_t *used)
+{
+    fwrite(buffer, 1, *used, file);
+    *used = 0;
+}
+
+/*
+    Turns an object file back into source the assembler accepts. Each
+    word's text comes from a decode table built once for all 65536 words,
+    so the per-word work is a table lookup and a few copies into one big
+    output buffer. PC-relative targets inside the image get their label
+    from the symbol file, or a generated Lxxxx label. A target outside it
+    cannot be named, so that word becomes a .FILL. Runs of unlabeled zero
+    words collapse into .BLKW.
+*/
+bool disassembleFile(const char *inputPath, const char *symbolPath, const char *outputPath)
+{
+    double start = monotonicSeconds();
+
+    MemoryImage *image = (MemoryImage *)malloc(sizeof(MemoryImage));
+    DisassemblyTable *table = (DisassemblyTable *)malloc(sizeof(DisassemblyTable));
+    const char **labelAt = (const char **)calloc(LC3_MEMORY_WORDS, sizeof(const char *));
+    char *buffer = (char *)malloc(DISASSEMBLY_BUFFER_SIZE);
+    if (!image || !table || !labelAt || !buffer)
+    {
+        fprintf(stderr, "Memory allocation failed.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    int wordCount;
+    if (!readObjectFile(inputPath, image, &wordCount))
+    {
+        free(buffer);
+        free(labelAt);
+        free(table);
+        free(image);
+        return false;
+    }
+
+    FILE *file = strcmp(outputPath, "-") == 0 ? stdout : fopen(outputPath, "w");
+    if (file == NULL)
+    {
+        fprintf(logStream, "Error opening file %s.\n", outputPath);
+        free(buffer);
+        free(labelAt);
+        free(table);
+        free(image);
+        return false;
+    }
+
+    Arena names;
+    initArena(&names);
+    int symbolCount = -1;
+    if (symbolPath != NULL)
+    {
+        symbolCount = readSymbolFile(symbolPath, &names, labelAt);
+        if (symbolCount < 0)
+        {
+            LOG_ERROR("Error opening symbol file %s.\n", symbolPath);
+        }
+    }
+    else if (strcmp(inputPath, "-") != 0)
+    {
+        // The text file next to the object, or else the binary table
+        const char *extensions[] = { ".sym", ".lsym" };
+        int i;
+        for (i = 0; i < 2 && symbolCount < 0; i++)
+        {
+            char *defaultSymbolPath = symbolPathFor(inputPath, extensions[i]);
+            symbolCount = readSymbolFile(defaultSymbolPath, &names, labelAt);
+            free(defaultSymbolPath);
+        }
+    }
+
+    buildDisassemblyTable(table);
+
+    int origin = image->origin;
+    int i;
+
+    // Every in-image target without a symbol gets a generated label
+    for (i = 0; i < wordCount; i++)
+    {
+        uint16_t word = image->words[(origin + i) & 0xFFFF];
+        const DisassemblyEntry *entry = &table->entries[word];
+        if (entry->targetBits == 0)
+        {
+            continue;
+        }
+        int target = (origin + i + 1 + signExtend(word, entry->targetBits)) & 0xFFFF;
+        if (((target - origin) & 0xFFFF) < wordCount && labelAt[target] == NULL)
+        {
+            char generated[8];
+            sprintf(generated, "L%04X", target);
+            labelAt[target] = arenaStrndup(&names, generated, 5);
+        }
+    }
+
+    size_t used = (size_t)sprintf(buffer, "        .ORIG x%04X\n", origin);
+    for (i = 0; i < wordCount; i++)
+    {
+        if (used > DISASSEMBLY_BUFFER_SIZE - DISASSEMBLY_LINE_SLACK)
+        {
+            flushDisassembly(file, buffer, &used);
+        }
+
+        int address = (origin + i) & 0xFFFF;
+        uint16_t word = image->words[address];
+        const char *label = labelAt[address];
+
+        if (label != NULL)
+        {
+            size_t labelLength = strlen(label);
+            if (labelLength > DISASSEMBLY_MAX_LABEL)
+            {
+                labelLength = DISASSEMBLY_MAX_LABEL;
+            }
+            memcpy(buffer + used, label, labelLength);
+            used += labelLength;
+            buffer[used++] = ' ';
+            while (labelLength++ < 7)
+            {
+                buffer[used++] = ' ';
+            }
+        }
+        else
+        {
+            memcpy(buffer + used, "        ", 8);
+            used += 8;
+        }
+
+        if (word == 0)
+        {
+            int run = 1;
+            while (i + run < wordCount && image->words[(address + run) & 0xFFFF] == 0 && labelAt[(address + run) & 0xFFFF] == NULL)
+            {
+                run++;
+            }
+            if (run > 1)
+            {
+                int length = 0;
+                char *line = buffer + used;
+                memcpy(line, ".BLKW ", 6);
+                length = 6;
+                appendDecimal(line, &length, run);
+                memcpy(line + length, " ; ", 3);
+                length += 3;
+                appendHex(line, &length, address, 4);
+                line[length++] = '\n';
+                used += length;
+                i += run - 1;
+                continue;
+            }
+        }
+
+        const DisassemblyEntry *entry = &table->entries[word];
+        int target = entry->targetBits != 0 ? (address + 1 + signExtend(word, entry->targetBits)) & 0xFFFF : 0;
+        if (entry->targetBits != 0 && (labelAt[target] == NULL || ((target - origin) & 0xFFFF) >= wordCount))
+        {
+            /*
+                The assembler only takes labels, and a label can only be
+                defined inside the image, so this word is kept as data with
+                the instruction it encodes in the comment.
+            */
+            int length = 0;
+            char *line = buffer + used;
+            memcpy(line, ".FILL #", 7);
+            length = 7;
+            appendDecimal(line, &length, (int16_t)word);
+            memcpy(line + length, " ; ", 3);
+            length += 3;
+            appendHex(line, &length, address, 4);
+            line[length++] = ' ';
+            appendHex(line, &length, word, 4);
+            line[length++] = ' ';
+            memcpy(line + length, entry->text, entry->length);
+            length += entry->length;
+            appendHex(line, &length, target, 4);
+            line[length++] = '\n';
+            used += length;
+            continue;
+        }
+
+        memcpy(buffer + used, entry->text, entry->length);
+        used += entry->length;
+
+        if (entry->targetBits != 0)
+        {
+            size_t labelLength = strlen(labelAt[target]);
+            if (labelLength > DISASSEMBLY_MAX_LABEL)
+            {
+                labelLength = DISASSEMBLY_MAX_LABEL;
+            }
+            memcpy(buffer + used, labelAt[target], labelLength);
+            used += labelLength;
+        }
+
+        int length = 0;
+        char *comment = buffer + used;
+        memcpy(comment, " ; ", 3);
+        length = 3;
+        appendHex(comment, &length, address, 4);
+        comment[length++] = ' ';
+        appendHex(comment, &length, word, 4);
+        comment[length++] = '\n';
+        used += length;
+    }
+
+    memcpy(buffer + used, "        .END\n", 13);
+    used += 13;
+    flushDisassembly(file, buffer, &used);
+
+    if (file != stdout)
+    {
+        fclose(file);
+    }
+    else
+    {
+        fflush(file);
+    }
+
+    LOG_TRACE("Disassembled %d words with %d symbols in %.2f ms.\n", wordCount, symbolCount < 0 ? 0 : symbolCount, (monotonicSeconds() - start) * 1e3);
+
+    freeArena(&names);
+    free(buffer);
+    free(labelAt);
+    free(table);
+    free(image);
+    return true;
+}
+
+#endif
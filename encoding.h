@@ -0,0 +1,82 @@
+#ifndef ENCODING_H
+#define ENCODING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+bool fitsInBits(int value, int bits)
+{
+    int maxVal = (1 << (bits - 1)) - 1;
+    int minVal = -maxVal - 1;
+    return value >= minVal && value <= maxVal;
+}
+
+/*
+    Builds the 16-bit LC-3 word straight from typed operands.
+    instructionMap is laid out in BinOps order, so the opcode is one index.
+
+        ADD/AND  opcode | DR | SR1 | 0 | 00 | SR2
+        ADD/AND  opcode | DR | SR1 | 1 | imm5
+        BR       0000   | n z p    | PCoffset9
+        LD/LDI/LEA/ST/STI opcode | DR/SR | PCoffset9
+        LDR/STR  opcode | DR/SR | BaseR | offset6
+        NOT      1001   | DR | SR | 111111
+        TRAP     1111   | 0000 | trapvect8
+        JMP/RET  1100   | 000 | BaseR | 000000   (RET is BaseR = R7)
+        JSR      0100   | 1 | PCoffset11
+        JSRR     0100   | 0 | 00 | BaseR | 000000
+        RTI      1000   | 000000000000
+*/
+uint16_t encodeInstruction(BinOps binaryOps, const Operands *operands)
+{
+    uint16_t word = (uint16_t)(instructionMap[binaryOps].opcodeBits << 12);
+
+    switch (binaryOps)
+    {
+        case ADD_ONE_OP:
+        case AND_ONE_OP:
+            return word | (operands->dr << 9) | (operands->sr1 << 6) | operands->sr2;
+        case ADD_TWO_OP:
+        case AND_TWO_OP:
+            return word | (operands->dr << 9) | (operands->sr1 << 6) | (1 << 5) | (operands->imm & 0x1F);
+        case BR_OP:
+            return word | (operands->conditions << 9) | (operands->imm & 0x1FF);
+        case LD_OP:
+        case LDI_OP:
+        case LEA_OP:
+        case ST_OP:
+        case STI_OP:
+            return word | (operands->dr << 9) | (operands->imm & 0x1FF);
+        case LDR_OP:
+        case STR_OP:
+            return word | (operands->dr << 9) | (operands->sr1 << 6) | (operands->imm & 0x3F);
+        case NOT_OP:
+            return word | (operands->dr << 9) | (operands->sr1 << 6) | 0x3F;
+        case TRAP_OP:
+            return word | (operands->imm & 0xFF);
+        case JMP_OP:
+        case JSRR_OP:
+            return word | (operands->sr1 << 6);
+        case RET_OP:
+            return word | (R7 << 6);
+        case JSR_OP:
+            return word | (1 << 11) | (operands->imm & 0x7FF);
+        case RTI_OP:
+            return word;
+        default:
+            return word;
+    }
+}
+
+// Text rendering is only needed for the listing, so it is kept out of the encoder
+void wordToBinary(uint16_t word, char *binaryOut)
+{
+    int i;
+    for (i = 15; i >= 0; i--, word >>= 1)
+    {
+        binaryOut[i] = (word & 1) + '0';
+    }
+    binaryOut[16] = '\0';
+}
+
+#endif
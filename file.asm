@@ -17,11 +17,12 @@ LOOPADD:
             BRp LOOPADD ; Loop if positive
             TRAP x22
 
-HALT:
-        .BLKW 254 ; (254 because x3100 - x3001 (LD command for R1) - 1 (To account for PC) = 254 in decimal)
 NUMX    .FILL #11 ; x=11
 DATA    .FILL #6
 POINTER .FILL #5
 VAL     .FILL #1
 STORLOC .FILL #4
+
+HALT:
+        .BLKW 254 ; Reserved after the data so LD, LDI, ST and STI stay within their 9-bit offsets
         .END
\ No newline at end of file
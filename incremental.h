@@ -0,0 +1,552 @@
+#ifndef INCREMENTAL_H
+#define INCREMENTAL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <limits.h>
+
+#define ENGINE_INITIAL_LINES 256
+
+/*
+    The incremental engine keeps what the last run learned about every
+    line: its text and hash, its first-pass summary, the words it emitted,
+    the label its PC offset points at and what it logged. An edit replaces
+    a range of lines. Only the lines that really differ are lexed again.
+    The symbols are only laid out again when a label, a .ORIG or a .END
+    changed. When only the number of words did, the labels below the edit
+    are moved in place. After that, a line is re-encoded only if it is new
+    or its PC offset actually moved. Lines that just shift keep their
+    words and get a new address.
+
+    The output matches assembleFile in two-pass mode, except that each
+    duplicate label is reported with its line instead of ahead of
+    everything else.
+*/
+void initAssemblyEngine(AssemblyEngine *engine)
+{
+    engine->lines = NULL;
+    engine->lineCount = 0;
+    engine->lineCapacity = 0;
+    initArena(&engine->names);
+    initSymbolTable(&engine->symbols, &engine->names);
+    engine->lineErrors = 0;
+    engine->duplicateLabels = 0;
+    engine->changedLines = NULL;
+    engine->changedCount = 0;
+    engine->changedCapacity = 0;
+    engine->relexedLines = 0;
+    engine->reassembledLines = 0;
+    engine->milliseconds = 0;
+}
+
+void freeAssembledLine(AssembledLine *line)
+{
+    int i;
+    for (i = 0; i < line->entryCount; i++)
+    {
+        free(line->entries[i].characters);
+    }
+    free(line->entries);
+    free(line->referencedLabel);
+    free(line->diagnostics);
+    free(line->text);
+}
+
+void freeAssemblyEngine(AssemblyEngine *engine)
+{
+    int i;
+    for (i = 0; i < engine->lineCount; i++)
+    {
+        freeAssembledLine(&engine->lines[i]);
+    }
+    free(engine->lines);
+    free(engine->changedLines);
+    freeSymbolTable(&engine->symbols);
+    freeArena(&engine->names);
+    engine->lines = NULL;
+    engine->lineCount = 0;
+    engine->lineCapacity = 0;
+    engine->changedLines = NULL;
+    engine->changedCount = 0;
+    engine->changedCapacity = 0;
+}
+
+int engineErrors(const AssemblyEngine *engine)
+{
+    return engine->lineErrors + engine->duplicateLabels;
+}
+
+void initAssembledLine(AssembledLine *line, const char *text, size_t length, unsigned int hash)
+{
+    line->text = (char *)malloc(length + 1);
+    if (!line->text)
+    {
+        fprintf(stderr, "Memory allocation failed.\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(line->text, text, length);
+    line->text[length] = '\0';
+    line->length = length;
+    line->hash = hash;
+    summarizeLine(line->text, length, &line->summary);
+    line->symbolIndex = -1;
+    line->address = 0;
+    line->nextAddress = 0;
+    line->absolute = false;
+    line->entries = NULL;
+    line->entryCount = 0;
+    line->referencedLabel = NULL;
+    line->targetIndex = -1;
+    line->offset = INT_MIN;
+    line->diagnostics = NULL;
+    line->diagnosticsLength = 0;
+    line->errors = 0;
+    line->duplicateLabel = false;
+}
+
+bool sameLineText(const AssembledLine *line, TokenView text, unsigned int hash)
+{
+    return line->hash == hash && line->length == text.length && memcmp(line->text, text.start, text.length) == 0;
+}
+
+// Whether the line can move other lines' addresses or the symbols
+bool affectsLayout(const LineSummary *summary)
+{
+    return summary->label != NULL || summary->origin >= 0 || summary->ends;
+}
+
+void noteChangedLine(AssemblyEngine *engine, int index)
+{
+    if (engine->changedCount == engine->changedCapacity)
+    {
+        int capacity = engine->changedCapacity ? engine->changedCapacity * 2 : ENGINE_INITIAL_LINES;
+        int *changedLines = (int *)realloc(engine->changedLines, capacity * sizeof(int));
+        if (!changedLines)
+        {
+            fprintf(stderr, "Memory allocation failed.\n");
+            exit(EXIT_FAILURE);
+        }
+        engine->changedLines = changedLines;
+        engine->changedCapacity = capacity;
+    }
+    engine->changedLines[engine->changedCount++] = index;
+}
+
+// The first pass again, over the summaries the lines already have
+void layoutEngineSymbols(AssemblyEngine *engine)
+{
+    clearSymbolTable(&engine->symbols);
+    arenaReset(&engine->names);
+    engine->duplicateLabels = 0;
+
+    int address = 0;
+    bool ended = false;
+    int i;
+    for (i = 0; i < engine->lineCount; i++)
+    {
+        AssembledLine *line = &engine->lines[i];
+        const LineSummary *summary = &line->summary;
+        line->symbolIndex = -1;
+        line->duplicateLabel = false;
+        if (ended)
+        {
+            continue;
+        }
+        if (summary->label != NULL)
+        {
+            if (addLabel(&engine->symbols, summary->label, summary->labelLength, i + 1, address))
+            {
+                line->symbolIndex = engine->symbols.count - 1;
+            }
+            else
+            {
+                line->duplicateLabel = true;
+                engine->duplicateLabels++;
+            }
+        }
+        if (summary->ends)
+        {
+            ended = true;
+            continue;
+        }
+        address = (summary->origin >= 0 ? summary->origin : address) + summary->size;
+    }
+}
+
+/*
+    When an edit only changed how many words there are, every label from
+    firstLine down to the next .ORIG moves by the same amount, and the set
+    of labels stays the same. Returns whether any label moved.
+*/
+bool shiftEngineSymbols(AssemblyEngine *engine, int firstLine, int sizeChange)
+{
+    bool moved = false;
+    int i;
+    for (i = firstLine; i < engine->lineCount; i++)
+    {
+        const AssembledLine *line = &engine->lines[i];
+        if (line->symbolIndex >= 0)
+        {
+            engine->symbols.entries[line->symbolIndex].address += sizeChange;
+            moved = true;
+        }
+        if (line->summary.origin >= 0 || line->summary.ends)
+        {
+            break;
+        }
+    }
+    return moved;
+}
+
+void resolveEngineTarget(AssemblyEngine *engine, AssembledLine *line)
+{
+    const LabelInfo *target = findSymbol(&engine->symbols, line->referencedLabel);
+    line->targetIndex = target != NULL ? (int)(target - engine->symbols.entries) : -1;
+}
+
+// The distance the line's PC offset encodes when it starts at address, INT_MIN while the label is undefined
+int engineOffset(const AssemblyEngine *engine, const AssembledLine *line, int address)
+{
+    return line->targetIndex >= 0 ? engine->symbols.entries[line->targetIndex].address - address : INT_MIN;
+}
+
+/*
+    Runs the second pass over one line with the writer deferred, so the
+    words end up as entries the line keeps, and with logStream pointing at
+    log, whose new text becomes the line's diagnostics.
+*/
+void reassembleLine(AssemblyEngine *engine, int index, int address, InstructionContext *context, FILE *log, char **logText, size_t *logLength)
+{
+    AssembledLine *line = &engine->lines[index];
+    OutputWriter *writer = context->writer;
+
+    fflush(log);
+    size_t logStart = *logLength;
+    int errorsBefore = errorCount;
+    writer->entryBase = 0;
+    writer->entryCount = 0;
+    context->referencedLabel = NULL;
+
+    int nextAddress = assembleLine(context, line->text, line->length, index, address);
+    fflush(log);
+
+    int i;
+    for (i = 0; i < line->entryCount; i++)
+    {
+        free(line->entries[i].characters);
+    }
+    free(line->entries);
+    free(line->referencedLabel);
+    free(line->diagnostics);
+
+    // The entries and any string characters they own move over to the line
+    line->entries = NULL;
+    line->entryCount = writer->entryCount;
+    line->absolute = false;
+    if (writer->entryCount > 0)
+    {
+        line->entries = (OutputEntry *)malloc(writer->entryCount * sizeof(OutputEntry));
+        if (!line->entries)
+        {
+            fprintf(stderr, "Memory allocation failed.\n");
+            exit(EXIT_FAILURE);
+        }
+        memcpy(line->entries, writer->entries, writer->entryCount * sizeof(OutputEntry));
+        for (i = 0; i < writer->entryCount; i++)
+        {
+            line->absolute |= writer->entries[i].kind == ENTRY_ORIGIN;
+        }
+    }
+    writer->entryCount = 0;
+
+    line->referencedLabel = context->referencedLabel != NULL ? strdup(context->referencedLabel) : NULL;
+    line->diagnosticsLength = *logLength - logStart;
+    line->diagnostics = line->diagnosticsLength > 0 ? strndup(*logText + logStart, line->diagnosticsLength) : NULL;
+    if ((context->referencedLabel != NULL && !line->referencedLabel) || (line->diagnosticsLength > 0 && !line->diagnostics))
+    {
+        fprintf(stderr, "Memory allocation failed.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    engine->lineErrors += (errorCount - errorsBefore) - line->errors;
+    line->errors = errorCount - errorsBefore;
+    line->address = address;
+    line->nextAddress = nextAddress;
+    line->targetIndex = -1;
+    if (line->referencedLabel != NULL)
+    {
+        resolveEngineTarget(engine, line);
+    }
+    line->offset = engineOffset(engine, line, address);
+}
+
+/*
+    Replaces lines [firstLine, firstLine + removedLines) with the lines in
+    text, which keep their newlines like a file's. Afterwards changedLines
+    lists the lines whose words or address changed, and relexedLines,
+    reassembledLines and milliseconds say what the edit cost.
+*/
+void editAssemblyEngine(AssemblyEngine *engine, int firstLine, int removedLines, const char *text, size_t length)
+{
+    double start = monotonicSeconds();
+    engine->changedCount = 0;
+    engine->relexedLines = 0;
+    engine->reassembledLines = 0;
+
+    if (firstLine < 0)
+    {
+        firstLine = 0;
+    }
+    if (firstLine > engine->lineCount)
+    {
+        firstLine = engine->lineCount;
+    }
+    if (removedLines < 0)
+    {
+        removedLines = 0;
+    }
+    if (removedLines > engine->lineCount - firstLine)
+    {
+        removedLines = engine->lineCount - firstLine;
+    }
+
+    // Every line but the last ends in a newline, so text cannot leave one open in front of another line
+    char *joined = NULL;
+    bool extendsLast = length > 0 && firstLine == engine->lineCount && firstLine > 0
+        && engine->lines[firstLine - 1].text[engine->lines[firstLine - 1].length - 1] != '\n';
+    bool endsOpen = length > 0 && text[length - 1] != '\n' && firstLine + removedLines < engine->lineCount;
+    if (extendsLast || endsOpen)
+    {
+        const AssembledLine *last = extendsLast ? &engine->lines[firstLine - 1] : NULL;
+        size_t lastLength = last != NULL ? last->length + 1 : 0;
+        joined = (char *)malloc(lastLength + length + 1);
+        if (!joined)
+        {
+            fprintf(stderr, "Memory allocation failed.\n");
+            exit(EXIT_FAILURE);
+        }
+        if (last != NULL)
+        {
+            memcpy(joined, last->text, last->length);
+            joined[last->length] = '\n';
+            firstLine--;
+            removedLines++;
+        }
+        memcpy(joined + lastLength, text, length);
+        length += lastLength;
+        if (endsOpen)
+        {
+            joined[length++] = '\n';
+        }
+        text = joined;
+    }
+
+    // Split text the way nextLine does, views into it with their hashes
+    int addedLines = 0;
+    size_t position;
+    for (position = 0; position < length; addedLines++)
+    {
+        const char *newline = (const char *)memchr(text + position, '\n', length - position);
+        position = newline != NULL ? (size_t)(newline - text) + 1 : length;
+    }
+    TokenView *added = (TokenView *)malloc((addedLines > 0 ? addedLines : 1) * sizeof(TokenView));
+    unsigned int *hashes = (unsigned int *)malloc((addedLines > 0 ? addedLines : 1) * sizeof(unsigned int));
+    if (!added || !hashes)
+    {
+        fprintf(stderr, "Memory allocation failed.\n");
+        exit(EXIT_FAILURE);
+    }
+    int i;
+    for (i = 0, position = 0; i < addedLines; i++)
+    {
+        const char *newline = (const char *)memchr(text + position, '\n', length - position);
+        size_t end = newline != NULL ? (size_t)(newline - text) + 1 : length;
+        added[i].start = text + position;
+        added[i].length = end - position;
+        hashes[i] = hashLabel(added[i].start, added[i].length);
+        position = end;
+    }
+
+    // Lines the edit sends back unchanged at either end of the range keep everything they had
+    int prefix = 0;
+    while (prefix < removedLines && prefix < addedLines && sameLineText(&engine->lines[firstLine + prefix], added[prefix], hashes[prefix]))
+    {
+        prefix++;
+    }
+    int suffix = 0;
+    while (suffix < removedLines - prefix && suffix < addedLines - prefix
+        && sameLineText(&engine->lines[firstLine + removedLines - 1 - suffix], added[addedLines - 1 - suffix], hashes[addedLines - 1 - suffix]))
+    {
+        suffix++;
+    }
+    firstLine += prefix;
+    removedLines -= prefix + suffix;
+    addedLines -= prefix + suffix;
+
+    bool layoutChanged = false;
+    int sizeChange = 0;
+    for (i = firstLine; i < firstLine + removedLines; i++)
+    {
+        AssembledLine *line = &engine->lines[i];
+        layoutChanged |= affectsLayout(&line->summary);
+        sizeChange -= line->summary.size;
+        engine->lineErrors -= line->errors;
+        freeAssembledLine(line);
+    }
+
+    int lineCount = engine->lineCount - removedLines + addedLines;
+    if (lineCount > engine->lineCapacity)
+    {
+        int capacity = engine->lineCapacity ? engine->lineCapacity : ENGINE_INITIAL_LINES;
+        while (capacity < lineCount)
+        {
+            capacity *= 2;
+        }
+        AssembledLine *lines = (AssembledLine *)realloc(engine->lines, capacity * sizeof(AssembledLine));
+        if (!lines)
+        {
+            fprintf(stderr, "Memory allocation failed.\n");
+            exit(EXIT_FAILURE);
+        }
+        engine->lines = lines;
+        engine->lineCapacity = capacity;
+    }
+    memmove(engine->lines + firstLine + addedLines, engine->lines + firstLine + removedLines,
+        (engine->lineCount - firstLine - removedLines) * sizeof(AssembledLine));
+    engine->lineCount = lineCount;
+
+    for (i = 0; i < addedLines; i++)
+    {
+        AssembledLine *line = &engine->lines[firstLine + i];
+        initAssembledLine(line, added[prefix + i].start, added[prefix + i].length, hashes[prefix + i]);
+        layoutChanged |= affectsLayout(&line->summary);
+        sizeChange += line->summary.size;
+    }
+    engine->relexedLines = addedLines;
+    free(added);
+    free(hashes);
+    free(joined);
+
+    // Symbols only move when a label, an origin or a size did
+    bool symbolsMoved = false;
+    if (layoutChanged)
+    {
+        layoutEngineSymbols(engine);
+        symbolsMoved = true;
+    }
+    else if (sizeChange != 0)
+    {
+        symbolsMoved = shiftEngineSymbols(engine, firstLine + addedLines, sizeChange);
+    }
+
+    OutputWriter writer;
+    initOutputWriter(&writer, NULL, FORMAT_LISTING);
+    writer.deferred = true;
+    Arena scratch;
+    initArena(&scratch);
+    InstructionContext context;
+    context.symbols = &engine->symbols;
+    context.fixups = NULL;
+    context.writer = &writer;
+    context.scratch = &scratch;
+    context.referencedLabel = NULL;
+
+    char *logText = NULL;
+    size_t logLength = 0;
+    FILE *log = open_memstream(&logText, &logLength);
+    if (log == NULL)
+    {
+        fprintf(stderr, "Memory allocation failed.\n");
+        exit(EXIT_FAILURE);
+    }
+    FILE *savedLogStream = logStream;
+    int savedErrorCount = errorCount;
+    logStream = log;
+
+    // Moved symbols can change offsets above the edit too, so then every line is looked at
+    int startLine = symbolsMoved ? 0 : firstLine;
+    int address = startLine > 0 ? engine->lines[startLine - 1].nextAddress : 0;
+    for (i = startLine; i < engine->lineCount; i++)
+    {
+        AssembledLine *line = &engine->lines[i];
+        bool fresh = i >= firstLine && i < firstLine + addedLines;
+        if (!fresh && !symbolsMoved && address == line->address)
+        {
+            // Same symbols and the same address from here on, nothing further down can change
+            break;
+        }
+        if (layoutChanged && !fresh && line->referencedLabel != NULL)
+        {
+            resolveEngineTarget(engine, line); // The old entries are gone
+        }
+
+        if (fresh || (line->referencedLabel != NULL && engineOffset(engine, line, address) != line->offset))
+        {
+            reassembleLine(engine, i, address, &context, log, &logText, &logLength);
+            engine->reassembledLines++;
+            noteChangedLine(engine, i);
+        }
+        else if (address != line->address)
+        {
+            if (!line->absolute)
+            {
+                line->nextAddress += address - line->address;
+            }
+            line->address = address;
+            noteChangedLine(engine, i);
+        }
+        address = line->nextAddress;
+    }
+
+    logStream = savedLogStream;
+    errorCount = savedErrorCount;
+    fclose(log);
+    free(logText);
+    freeOutputWriter(&writer);
+    freeArena(&scratch);
+
+    engine->milliseconds = (monotonicSeconds() - start) * 1e3;
+    LOG_TRACE("Edit relexed %d lines and re-encoded %d in %.3f ms.\n", engine->relexedLines, engine->reassembledLines, engine->milliseconds);
+}
+
+// Starts over with a whole file, which is just an edit replacing every line
+void loadAssemblyEngine(AssemblyEngine *engine, const char *source, size_t length)
+{
+    editAssemblyEngine(engine, 0, engine->lineCount, source, length);
+}
+
+// Writes the words of every line, the same output assembleFile would produce; they go out once the writer is flushed or freed
+void writeAssemblyEngine(const AssemblyEngine *engine, OutputWriter *writer)
+{
+    int i;
+    int j;
+    for (i = 0; i < engine->lineCount; i++)
+    {
+        const AssembledLine *line = &engine->lines[i];
+        for (j = 0; j < line->entryCount; j++)
+        {
+            replayOutputEntry(writer, &line->entries[j]);
+        }
+    }
+}
+
+void writeAssemblyEngineDiagnostics(const AssemblyEngine *engine, FILE *file)
+{
+    int i;
+    for (i = 0; i < engine->lineCount; i++)
+    {
+        const AssembledLine *line = &engine->lines[i];
+        if (line->duplicateLabel && LOG_ENABLED(VERBOSITY_ERRORS))
+        {
+            fprintf(file, "Duplicate label: %.*s\n", (int)line->summary.labelLength, line->summary.label);
+        }
+        if (line->diagnosticsLength > 0)
+        {
+            fwrite(line->diagnostics, 1, line->diagnosticsLength, file);
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,174 @@
+#ifndef INSTRUCTIONS_H
+#define INSTRUCTIONS_H
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Instructions come first in Tokens, so the token value indexes this table directly
+const InstructionDescriptor instructionDescriptors[] = {
+    [ADD] = {"ADD", SHAPE_REG_REG_REG_OR_IMM5, ADD_ONE_OP, ADD_TWO_OP, "DR", parseADD, NULL},
+    [AND] = {"AND", SHAPE_REG_REG_REG_OR_IMM5, AND_ONE_OP, AND_TWO_OP, "DR", parseAND, NULL},
+    [BR] = {"BR", SHAPE_BRANCH, BR_OP, INVALID_OP, NULL, NULL, NULL},
+    [LD] = {"LD", SHAPE_REG_PCOFFSET9, LD_OP, INVALID_OP, "DR", NULL, parseLD},
+    [LDI] = {"LDI", SHAPE_REG_PCOFFSET9, LDI_OP, INVALID_OP, "DR", NULL, parseLDI},
+    [LDR] = {"LDR", SHAPE_REG_REG_OFFSET6, LDR_OP, INVALID_OP, "DR", parseLDR, NULL},
+    [LEA] = {"LEA", SHAPE_REG_PCOFFSET9, LEA_OP, INVALID_OP, "DR", NULL, parseLEA},
+    [NOT] = {"NOT", SHAPE_REG_REG, NOT_OP, INVALID_OP, "DR", parseNOT, NULL},
+    [ST] = {"ST", SHAPE_REG_PCOFFSET9, ST_OP, INVALID_OP, "SR", NULL, parseST},
+    [STI] = {"STI", SHAPE_REG_PCOFFSET9, STI_OP, INVALID_OP, "SR", NULL, parseSTI},
+    [STR] = {"STR", SHAPE_REG_REG_OFFSET6, STR_OP, INVALID_OP, "SR", parseSTR, NULL},
+    [TRAP] = {"TRAP", SHAPE_TRAPVECT8, TRAP_OP, INVALID_OP, NULL, NULL, NULL},
+    [JMP] = {"JMP", SHAPE_BASE_REG, JMP_OP, INVALID_OP, "BaseR", parseJMP, NULL},
+    [JSR] = {"JSR", SHAPE_PCOFFSET11, JSR_OP, INVALID_OP, NULL, NULL, NULL},
+    [JSRR] = {"JSRR", SHAPE_BASE_REG, JSRR_OP, INVALID_OP, "BaseR", parseJSRR, NULL},
+    [RET] = {"RET", SHAPE_NONE, RET_OP, INVALID_OP, NULL, NULL, NULL},
+    [RTI] = {"RTI", SHAPE_NONE, RTI_OP, INVALID_OP, NULL, NULL, NULL},
+    [GETC] = {"GETC", SHAPE_NONE, TRAP_OP, INVALID_OP, NULL, NULL, NULL, 0x20, "; GETC statement responsible for reading one character into R0"},
+    [OUT] = {"OUT", SHAPE_NONE, TRAP_OP, INVALID_OP, NULL, NULL, NULL, 0x21, "; OUT statement responsible for writing the character in R0"},
+    [PUTS] = {"PUTS", SHAPE_NONE, TRAP_OP, INVALID_OP, NULL, NULL, NULL, 0x22, "; PUTS statement responsible for writing the string R0 points to"},
+    [IN] = {"IN", SHAPE_NONE, TRAP_OP, INVALID_OP, NULL, NULL, NULL, 0x23, "; IN statement responsible for prompting for and echoing one character into R0"},
+    [PUTSP] = {"PUTSP", SHAPE_NONE, TRAP_OP, INVALID_OP, NULL, NULL, NULL, 0x24, "; PUTSP statement responsible for writing the packed string R0 points to"},
+    [HALT] = {"HALT", SHAPE_NONE, TRAP_OP, INVALID_OP, NULL, NULL, NULL, 0x25, "; HALT statement responsible for invoking the halt syscall"},
+};
+
+bool isInstructionToken(Tokens token)
+{
+    return token < (Tokens)(sizeof(instructionDescriptors) / sizeof(instructionDescriptors[0]));
+}
+
+/*
+    Stands in for an instruction or .FILL that did not assemble. Pass 1 gave
+    it a word, so one must be emitted for the addresses after it to stay
+    where the symbol table put them.
+*/
+void emitPlaceholderWord(OutputWriter *writer)
+{
+    emitInstruction(writer, 0x0000, "; ERROR: line did not assemble, placeholder word");
+}
+
+/*
+    The one parse -> encode -> emit path every instruction takes. The
+    descriptor's shape decides how operands are read; the mnemonic is only
+    needed for BR, whose condition codes are part of it. Returns true when
+    a word was emitted.
+*/
+bool assembleInstruction(const InstructionDescriptor *descriptor, const char *mnemonic, Lexer *lexer, InstructionContext *context, int currentAddress)
+{
+    Operands operands = {0};
+    BinOps binaryOps = descriptor->registerForm;
+
+    switch (descriptor->shape)
+    {
+        case SHAPE_REG_REG_REG_OR_IMM5:
+        case SHAPE_REG_REG:
+        case SHAPE_REG_REG_OFFSET6:
+        case SHAPE_BASE_REG:
+            if (!descriptor->parseRegisterOperands(lexer, &operands))
+            {
+                LOG_ERROR("Invalid operands for %s instruction.\n", descriptor->mnemonic);
+                lexer->index = lexer->length; // The parser stops at the bad operand, the rest is not a label
+                return false;
+            }
+            if (operands.immediate)
+            {
+                if (!fitsInBits(operands.imm, IMMEDIATE_SIZE_ADD_AND))
+                {
+                    LOG_ERROR("Immediate value #%d does not fit in %d bits.\n", operands.imm, IMMEDIATE_SIZE_ADD_AND);
+                    return false;
+                }
+                binaryOps = descriptor->immediateForm;
+            }
+            if (LOG_ENABLED(VERBOSITY_TRACE))
+            {
+                // The operands as written, without the spacing
+                switch (descriptor->shape)
+                {
+                    case SHAPE_REG_REG_REG_OR_IMM5:
+                        fprintf(logStream, operands.immediate ? "Operands: R%d,R%d,#%d\n" : "Operands: R%d,R%d,R%d\n", operands.dr, operands.sr1, operands.immediate ? operands.imm : operands.sr2);
+                        break;
+                    case SHAPE_REG_REG:
+                        fprintf(logStream, "Operands: R%d,R%d\n", operands.dr, operands.sr1);
+                        break;
+                    case SHAPE_REG_REG_OFFSET6:
+                        fprintf(logStream, "Operands: R%d,R%d,#%d\n", operands.dr, operands.sr1, operands.imm);
+                        break;
+                    default:
+                        fprintf(logStream, "Operands: R%d\n", operands.sr1);
+                        break;
+                }
+            }
+            break;
+        case SHAPE_REG_PCOFFSET9: {
+            char *label = allocTokenBuffer(lexer);
+            if (!descriptor->parseLabelOperands(lexer, &operands.dr, label))
+            {
+                LOG_ERROR("Invalid operands for %s instruction.\n", descriptor->mnemonic);
+                return false;
+            }
+            context->referencedLabel = label;
+            if (!resolveLabelOffset(context->symbols, context->fixups, context->writer, label, currentAddress, 9, &operands.imm))
+            {
+                return false;
+            }
+            break;
+        }
+        case SHAPE_BRANCH: {
+            const char *conditionCodes = mnemonic + 2;
+            if (strchr(conditionCodes, 'n')) operands.conditions |= 0x4;
+            if (strchr(conditionCodes, 'z')) operands.conditions |= 0x2;
+            if (strchr(conditionCodes, 'p')) operands.conditions |= 0x1;
+
+            char *label = allocTokenBuffer(lexer);
+            bool parsed = parseBR(lexer, label);
+            if (parsed)
+            {
+                context->referencedLabel = label;
+            }
+            if (!parsed || !resolveLabelOffset(context->symbols, context->fixups, context->writer, label, currentAddress, 9, &operands.imm))
+            {
+                LOG_ERROR("Invalid BR instruction or label not found: %s\n", label);
+                return false;
+            }
+            LOG_TRACE("Offset: %d\n", operands.imm);
+            break;
+        }
+        case SHAPE_PCOFFSET11: {
+            char *label = allocTokenBuffer(lexer);
+            if (!parseJSR(lexer, label))
+            {
+                LOG_ERROR("Invalid operands for %s instruction.\n", descriptor->mnemonic);
+                return false;
+            }
+            context->referencedLabel = label;
+            if (!resolveLabelOffset(context->symbols, context->fixups, context->writer, label, currentAddress, 11, &operands.imm))
+            {
+                return false;
+            }
+            break;
+        }
+        case SHAPE_TRAPVECT8:
+            if (!parseTRAP(lexer, &operands.imm))
+            {
+                LOG_ERROR("Failed to parse trap vector for TRAP directive.\n");
+                return false;
+            }
+            break;
+        case SHAPE_NONE:
+            operands.imm = descriptor->impliedImmediate;
+            break;
+    }
+
+    LOG_TRACE("\nValid operands for %s instruction.\n", descriptor->mnemonic);
+
+    uint16_t word = encodeInstruction(binaryOps, &operands);
+    const char *comment = descriptor->comment != NULL ? descriptor->comment : getCommentForInstruction(binaryOps);
+    LOG_TRACE("Opcode for %s: %s\n", descriptor->mnemonic, getOpcodeForToken(binaryOps));
+    LOG_TRACE("Encoded %s: x%04X\n", descriptor->mnemonic, word);
+
+    emitInstruction(context->writer, word, comment);
+    return true;
+}
+
+#endif
@@ -0,0 +1,479 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#if LC3_JIT_AVAILABLE
+#include <sys/mman.h>
+#endif
+
+/*
+    Tiered execution: runJit interprets, counts how often each address is
+    reached, and once one gets hot compiles the straight-line block
+    starting there into x86-64. A block ends after a BR, JMP/RET or
+    JSR/JSRR, or before anything native code does not handle (TRAP, RTI,
+    the reserved opcode), so traps and faults always go through the
+    interpreter.
+
+    Compiled code works on the Machine in place, with rbx pointing at it.
+    LC-3 registers stay in machine->registers, so any exit point leaves a
+    consistent state. Stores go through jitStore, and stores made by
+    interpreted instructions are checked in runJit. When a store lands on
+    compiled code, the blocks covering that word are dropped. If the store
+    came from a running block, that block returns right after it, so
+    modified code is decoded again before it runs. Dropped code is only reclaimed when the
+    buffer fills up and everything is flushed.
+*/
+bool initJit(JitState *jit, int threshold)
+{
+    memset(jit->blocks, 0, sizeof(jit->blocks));
+    memset(jit->coverage, 0, sizeof(jit->coverage));
+    memset(jit->heat, 0, sizeof(jit->heat));
+    jit->threshold = threshold;
+    jit->compiledBlocks = 0;
+    jit->droppedBlocks = 0;
+    jit->buffer = NULL;
+    jit->capacity = 0;
+    jit->used = 0;
+
+#if LC3_JIT_AVAILABLE
+    void *buffer = mmap(NULL, JIT_BUFFER_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buffer == MAP_FAILED)
+    {
+        return false;
+    }
+    jit->buffer = (unsigned char *)buffer;
+    jit->capacity = JIT_BUFFER_SIZE;
+    return true;
+#else
+    return false;
+#endif
+}
+
+void freeJit(JitState *jit)
+{
+#if LC3_JIT_AVAILABLE
+    if (jit->buffer != NULL)
+    {
+        munmap(jit->buffer, jit->capacity);
+    }
+#endif
+    jit->buffer = NULL;
+    jit->capacity = 0;
+    jit->used = 0;
+}
+
+// Forgets every block and starts the buffer over; only safe between blocks
+void flushJit(JitState *jit)
+{
+    int start;
+    for (start = 0; start < LC3_MEMORY_WORDS; start++)
+    {
+        if (jit->blocks[start].code != NULL)
+        {
+            dropJitBlock(jit, start);
+        }
+    }
+    jit->used = 0;
+}
+
+void dropJitBlock(JitState *jit, int start)
+{
+    JitBlock *block = &jit->blocks[start];
+    int i;
+    for (i = 0; i < block->length; i++)
+    {
+        jit->coverage[start + i]--;
+    }
+    block->code = NULL;
+    block->length = 0;
+    jit->droppedBlocks++;
+}
+
+// Blocks never wrap past xFFFF and are at most JIT_MAX_BLOCK_LENGTH long, so only that many starts can cover a word
+void invalidateJitWord(JitState *jit, uint16_t address)
+{
+    int first = address >= JIT_MAX_BLOCK_LENGTH - 1 ? address - (JIT_MAX_BLOCK_LENGTH - 1) : 0;
+    int start;
+    for (start = first; start <= address; start++)
+    {
+        const JitBlock *block = &jit->blocks[start];
+        if (block->code != NULL && start + block->length > address)
+        {
+            dropJitBlock(jit, start);
+        }
+    }
+}
+
+// Called from compiled code; non-zero tells the block to return because code was overwritten
+uint32_t jitStore(Machine *machine, uint32_t address, uint32_t value)
+{
+    storeMachineWord(machine, (uint16_t)address, (uint16_t)value);
+    if (machine->jit->coverage[address] == 0)
+    {
+        return 0;
+    }
+    invalidateJitWord(machine->jit, (uint16_t)address);
+    return 1;
+}
+
+// Where ST, STI or STR is about to write, -1 for anything else
+int storeTarget(const Machine *machine, const DecodedInstruction *instruction)
+{
+    switch (instruction->opcode)
+    {
+        case OPCODE_ST:
+            return (uint16_t)(machine->pc + 1 + instruction->offset);
+        case OPCODE_STI:
+            return machine->memory[(uint16_t)(machine->pc + 1 + instruction->offset)];
+        case OPCODE_STR:
+            return (uint16_t)(machine->registers[instruction->sr1] + instruction->offset);
+        default:
+            return -1;
+    }
+}
+
+bool isJitCompilable(const DecodedInstruction *instruction)
+{
+    switch (instruction->opcode)
+    {
+        case OPCODE_TRAP:
+        case OPCODE_RTI:
+        case OPCODE_RESERVED:
+            return false;
+        default:
+            return true;
+    }
+}
+
+// A BR that tests no condition is a no-op and lets the block carry on
+bool endsJitBlock(const DecodedInstruction *instruction)
+{
+    return (instruction->opcode == OPCODE_BR && instruction->dr != 0) || instruction->opcode == OPCODE_JMP || instruction->opcode == OPCODE_JSR;
+}
+
+void jitCode(JitState *jit, const uint8_t *bytes, int count)
+{
+    memcpy(jit->buffer + jit->used, bytes, count);
+    jit->used += count;
+}
+
+void jitImm32(JitState *jit, uint32_t value)
+{
+    uint8_t bytes[4] = { (uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24) };
+    jitCode(jit, bytes, 4);
+}
+
+#define JIT_EAX 0
+#define JIT_ECX 1
+#define JIT_EDX 2
+#define JIT_REGISTER_OFFSET(r) ((uint32_t)(offsetof(Machine, registers) + 2 * (r)))
+#define JIT_MEMORY_OFFSET(address) ((uint32_t)(offsetof(Machine, memory) + 2 * (address)))
+
+// movzx x86Register, word [rbx + registers[lc3Register]]
+void jitLoadRegister(JitState *jit, int x86Register, int lc3Register)
+{
+    jitCode(jit, (const uint8_t[]){ 0x0F, 0xB7, (uint8_t)(0x83 | (x86Register << 3)) }, 3);
+    jitImm32(jit, JIT_REGISTER_OFFSET(lc3Register));
+}
+
+// mov word [rbx + registers[lc3Register]], ax
+void jitStoreRegister(JitState *jit, int lc3Register)
+{
+    jitCode(jit, (const uint8_t[]){ 0x66, 0x89, 0x83 }, 3);
+    jitImm32(jit, JIT_REGISTER_OFFSET(lc3Register));
+}
+
+// movzx eax, word [rbx + rax * 2 + memory], eax already holding a 16-bit address
+void jitLoadMemory(JitState *jit)
+{
+    jitCode(jit, (const uint8_t[]){ 0x0F, 0xB7, 0x84, 0x43 }, 4);
+    jitImm32(jit, JIT_MEMORY_OFFSET(0));
+}
+
+// N, Z or P from ax into machine->conditions
+void jitSetConditions(JitState *jit)
+{
+    jitCode(jit, (const uint8_t[]){
+        0xB9, CONDITION_Z, 0x00, 0x00, 0x00, // mov ecx, Z
+        0x66, 0x85, 0xC0, // test ax, ax
+        0x74, 0x0C, // jz store
+        0xB9, CONDITION_P, 0x00, 0x00, 0x00, // mov ecx, P
+        0x79, 0x05, // jns store
+        0xB9, CONDITION_N, 0x00, 0x00, 0x00, // mov ecx, N
+        0x88, 0x8B // store: mov byte [rbx + conditions], cl
+    }, 24);
+    jitImm32(jit, (uint32_t)offsetof(Machine, conditions));
+}
+
+// mov eax, nextPc | count << 16; pop rbx; ret
+void jitExit(JitState *jit, uint16_t nextPc, int count)
+{
+    jitCode(jit, (const uint8_t[]){ 0xB8 }, 1);
+    jitImm32(jit, (uint32_t)nextPc | ((uint32_t)count << 16));
+    jitCode(jit, (const uint8_t[]){ 0x5B, 0xC3 }, 2);
+}
+
+// jitStore(machine, esi, edx), leaving the block if it overwrote compiled code
+void jitCallStore(JitState *jit, uint16_t nextPc, int count)
+{
+    uintptr_t target = (uintptr_t)&jitStore;
+    jitCode(jit, (const uint8_t[]){ 0x48, 0x89, 0xDF }, 3); // mov rdi, rbx
+    jitCode(jit, (const uint8_t[]){ 0x48, 0xB8 }, 2); // mov rax, jitStore
+    jitImm32(jit, (uint32_t)target);
+    jitImm32(jit, (uint32_t)((uint64_t)target >> 32));
+    jitCode(jit, (const uint8_t[]){ 0xFF, 0xD0, 0x85, 0xC0, 0x74, 0x07 }, 6); // call rax; test eax, eax; jz past the exit
+    jitExit(jit, nextPc, count);
+}
+
+/*
+    Condition codes are only written where they can be seen: by the last
+    instruction that sets them before the block ends or before a store,
+    since a store may return early.
+*/
+bool compileJitBlock(JitState *jit, Machine *machine, uint16_t start)
+{
+#if LC3_JIT_AVAILABLE
+    const DecodedInstruction *decoded = &machine->decoded[start];
+    int length = 0;
+    bool terminated = false;
+    while (length < JIT_MAX_BLOCK_LENGTH && start + length < LC3_MEMORY_WORDS && isJitCompilable(&decoded[length]))
+    {
+        length++;
+        if (endsJitBlock(&decoded[length - 1]))
+        {
+            terminated = true;
+            break;
+        }
+    }
+    if (length == 0)
+    {
+        return false;
+    }
+
+    bool setsConditions[JIT_MAX_BLOCK_LENGTH];
+    bool observed = true;
+    int i;
+    for (i = length - 1; i >= 0; i--)
+    {
+        setsConditions[i] = false;
+        switch (decoded[i].opcode)
+        {
+            case OPCODE_ST:
+            case OPCODE_STI:
+            case OPCODE_STR:
+                observed = true;
+                break;
+            case OPCODE_ADD:
+            case OPCODE_AND:
+            case OPCODE_NOT:
+            case OPCODE_LD:
+            case OPCODE_LDI:
+            case OPCODE_LDR:
+                setsConditions[i] = observed;
+                observed = false;
+                break;
+        }
+    }
+
+    if (jit->capacity - jit->used < JIT_MAX_BLOCK_BYTES)
+    {
+        flushJit(jit);
+    }
+
+    unsigned char *code = jit->buffer + jit->used;
+    jitCode(jit, (const uint8_t[]){ 0x53, 0x48, 0x89, 0xFB }, 4); // push rbx; mov rbx, rdi
+
+    for (i = 0; i < length; i++)
+    {
+        const DecodedInstruction *instruction = &decoded[i];
+        uint16_t nextPc = (uint16_t)(start + i + 1);
+        uint16_t target = (uint16_t)(nextPc + instruction->offset);
+
+        switch (instruction->opcode)
+        {
+            case OPCODE_ADD:
+            case OPCODE_AND:
+                jitLoadRegister(jit, JIT_EAX, instruction->sr1);
+                if (instruction->immediate)
+                {
+                    jitCode(jit, (const uint8_t[]){ instruction->opcode == OPCODE_ADD ? 0x05 : 0x25 }, 1); // add/and eax, imm32
+                    jitImm32(jit, (uint32_t)(int32_t)instruction->offset);
+                }
+                else
+                {
+                    jitLoadRegister(jit, JIT_ECX, instruction->sr2);
+                    jitCode(jit, (const uint8_t[]){ instruction->opcode == OPCODE_ADD ? 0x01 : 0x21, 0xC8 }, 2); // add/and eax, ecx
+                }
+                jitStoreRegister(jit, instruction->dr);
+                break;
+            case OPCODE_NOT:
+                jitLoadRegister(jit, JIT_EAX, instruction->sr1);
+                jitCode(jit, (const uint8_t[]){ 0xF7, 0xD0 }, 2); // not eax
+                jitStoreRegister(jit, instruction->dr);
+                break;
+            case OPCODE_LD:
+                jitCode(jit, (const uint8_t[]){ 0x0F, 0xB7, 0x83 }, 3); // movzx eax, word [rbx + memory[target]]
+                jitImm32(jit, JIT_MEMORY_OFFSET(target));
+                jitStoreRegister(jit, instruction->dr);
+                break;
+            case OPCODE_LDI:
+                jitCode(jit, (const uint8_t[]){ 0x0F, 0xB7, 0x83 }, 3);
+                jitImm32(jit, JIT_MEMORY_OFFSET(target));
+                jitLoadMemory(jit);
+                jitStoreRegister(jit, instruction->dr);
+                break;
+            case OPCODE_LDR:
+                jitLoadRegister(jit, JIT_EAX, instruction->sr1);
+                jitCode(jit, (const uint8_t[]){ 0x05 }, 1); // add eax, offset6
+                jitImm32(jit, (uint32_t)(int32_t)instruction->offset);
+                jitCode(jit, (const uint8_t[]){ 0x0F, 0xB7, 0xC0 }, 3); // movzx eax, ax
+                jitLoadMemory(jit);
+                jitStoreRegister(jit, instruction->dr);
+                break;
+            case OPCODE_LEA:
+                jitCode(jit, (const uint8_t[]){ 0xB8 }, 1); // mov eax, target
+                jitImm32(jit, target);
+                jitStoreRegister(jit, instruction->dr);
+                break;
+            case OPCODE_ST:
+                jitCode(jit, (const uint8_t[]){ 0xBE }, 1); // mov esi, target
+                jitImm32(jit, target);
+                jitLoadRegister(jit, JIT_EDX, instruction->dr);
+                jitCallStore(jit, nextPc, i + 1);
+                break;
+            case OPCODE_STI:
+                jitCode(jit, (const uint8_t[]){ 0x0F, 0xB7, 0xB3 }, 3); // movzx esi, word [rbx + memory[target]]
+                jitImm32(jit, JIT_MEMORY_OFFSET(target));
+                jitLoadRegister(jit, JIT_EDX, instruction->dr);
+                jitCallStore(jit, nextPc, i + 1);
+                break;
+            case OPCODE_STR:
+                jitLoadRegister(jit, JIT_EAX, instruction->sr1);
+                jitCode(jit, (const uint8_t[]){ 0x05 }, 1);
+                jitImm32(jit, (uint32_t)(int32_t)instruction->offset);
+                jitCode(jit, (const uint8_t[]){ 0x0F, 0xB7, 0xF0 }, 3); // movzx esi, ax
+                jitLoadRegister(jit, JIT_EDX, instruction->dr);
+                jitCallStore(jit, nextPc, i + 1);
+                break;
+            case OPCODE_BR:
+                if (instruction->dr == 0)
+                {
+                    break;
+                }
+                if (instruction->dr != (CONDITION_N | CONDITION_Z | CONDITION_P))
+                {
+                    jitCode(jit, (const uint8_t[]){ 0xF6, 0x83 }, 2); // test byte [rbx + conditions], nzp
+                    jitImm32(jit, (uint32_t)offsetof(Machine, conditions));
+                    jitCode(jit, (const uint8_t[]){ instruction->dr, 0x74, 0x07 }, 3); // jz past the taken exit
+                }
+                jitExit(jit, target, i + 1);
+                jitExit(jit, nextPc, i + 1);
+                break;
+            case OPCODE_JMP:
+                jitLoadRegister(jit, JIT_EAX, instruction->sr1);
+                jitCode(jit, (const uint8_t[]){ 0x0D }, 1); // or eax, count << 16
+                jitImm32(jit, (uint32_t)(i + 1) << 16);
+                jitCode(jit, (const uint8_t[]){ 0x5B, 0xC3 }, 2);
+                break;
+            case OPCODE_JSR:
+                if (instruction->immediate)
+                {
+                    jitCode(jit, (const uint8_t[]){ 0xB8 }, 1); // mov eax, target
+                    jitImm32(jit, target | ((uint32_t)(i + 1) << 16));
+                }
+                else
+                {
+                    // BaseR is read before R7 is written, JSRR R7 jumps to the old R7
+                    jitLoadRegister(jit, JIT_EAX, instruction->sr1);
+                    jitCode(jit, (const uint8_t[]){ 0x0D }, 1);
+                    jitImm32(jit, (uint32_t)(i + 1) << 16);
+                }
+                jitCode(jit, (const uint8_t[]){ 0x66, 0xC7, 0x83 }, 3); // mov word [rbx + R7], nextPc
+                jitImm32(jit, JIT_REGISTER_OFFSET(7));
+                jitCode(jit, (const uint8_t[]){ (uint8_t)nextPc, (uint8_t)(nextPc >> 8), 0x5B, 0xC3 }, 4);
+                break;
+        }
+
+        if (setsConditions[i])
+        {
+            jitSetConditions(jit);
+        }
+    }
+
+    if (!terminated)
+    {
+        jitExit(jit, (uint16_t)(start + length), length);
+    }
+
+    JitBlock *block = &jit->blocks[start];
+    block->code = (JitBlockFunction)(void *)code;
+    block->length = length;
+    for (i = 0; i < length; i++)
+    {
+        jit->coverage[start + i]++;
+    }
+    jit->compiledBlocks++;
+    return true;
+#else
+    return false;
+#endif
+}
+
+/*
+    Same contract as runMachine: returns on HALT, a fault or the
+    instruction limit, with machine->executed exact. A block only runs
+    when the limit leaves room for all of it; otherwise the interpreter
+    steps up to the limit.
+*/
+RunResult runJit(Machine *machine, JitState *jit, long long instructionLimit)
+{
+    RunResult result = RUN_RUNNING;
+    machine->jit = jit;
+
+    while (result == RUN_RUNNING)
+    {
+        if (instructionLimit != 0 && machine->executed >= instructionLimit)
+        {
+            result = RUN_LIMIT;
+            break;
+        }
+
+        uint16_t pc = machine->pc;
+        JitBlock *block = &jit->blocks[pc];
+        if (block->code == NULL && ++jit->heat[pc] >= jit->threshold)
+        {
+            jit->heat[pc] = 0;
+            compileJitBlock(jit, machine, pc);
+        }
+
+        if (block->code != NULL && (instructionLimit == 0 || instructionLimit - machine->executed >= block->length))
+        {
+            uint32_t exit = block->code(machine);
+            machine->pc = (uint16_t)exit;
+            machine->executed += exit >> 16;
+            continue;
+        }
+
+        // One instruction through the switch loop, which knows nothing of compiled code, so its stores are checked here
+        int storeAddress = storeTarget(machine, &machine->decoded[pc]);
+        result = runMachine(machine, machine->executed + 1);
+        if (result == RUN_LIMIT)
+        {
+            result = RUN_RUNNING;
+        }
+        if (storeAddress >= 0 && jit->coverage[storeAddress] != 0)
+        {
+            invalidateJitWord(jit, (uint16_t)storeAddress);
+        }
+    }
+
+    machine->jit = NULL;
+    return result;
+}
+
+#endif
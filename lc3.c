@@ -0,0 +1,85 @@
+/*
+    The assembler as a library: every implementation header is compiled
+    here, once, and lc3.h declares what it provides. index.c is the command
+    line front end; anything else can link this file and call assemble.
+*/
+#include "lc3.h"
+
+_Thread_local Verbosity verbosity = VERBOSITY_ERRORS;
+_Thread_local FILE *logStream;
+_Thread_local int errorCount;
+
+const InstructionMap instructionMap[] = {
+    {ADD_ONE_OP, "0001", 0x1},
+    {ADD_TWO_OP, "0001", 0x1},
+    {AND_ONE_OP, "0101", 0x5},
+    {AND_TWO_OP, "0101", 0x5},
+    {BR_OP, "0000", 0x0},
+    {LD_OP, "0010", 0x2},
+    {LDI_OP, "1010", 0xA},
+    {LDR_OP, "0110", 0x6},
+    {LEA_OP, "1110", 0xE},
+    {NOT_OP, "1001", 0x9},
+    {ST_OP, "0011", 0x3},
+    {STI_OP, "1011", 0xB},
+    {STR_OP, "0111", 0x7},
+    {TRAP_OP, "1111", 0xF},
+    {JMP_OP, "1100", 0xC},
+    {JSR_OP, "0100", 0x4},
+    {JSRR_OP, "0100", 0x4},
+    {RET_OP, "1100", 0xC},
+    {RTI_OP, "1000", 0x8},
+    {INVALID_OP, "NULL", 0x0},
+};
+
+const CommentMap commentMap[] = {
+    {ADD_ONE_OP, "; ADD statement responsible for adding some SR1 and SR2, and placing the result in some DR."},
+    {ADD_TWO_OP, "; ADD statement responsible for adding some SR1 and Imm5, and placing the result in some DR."},
+    {AND_ONE_OP, "; AND statement responsible for anding some SR1 and SR2, and placing the result in some DR."},
+    {AND_TWO_OP, "; AND statement responsible for anding some SR1 and Imm5, and placing the result in some DR."},
+    {BR_OP, "; BR statement responsible for branching on some condition (n/z/p) to some defined LABEL"},
+    {LD_OP, "; LD statement responsible for loading some defined LABEL into some DR"},
+    {LDI_OP, "; LDI statement responsible for loading some defined LABEL indirectly into some DR"},
+    {LDR_OP, "; LDR statement responsible for loading some SR1 into DR, with some offset6"},
+    {LEA_OP, "; LEA statement responsible for loading the effective address of some defined LABEL into some DR"},
+    {NOT_OP, "; NOT statement responsible for notting some defined SR1 and placing the result in some DR"},
+    {ST_OP, "; ST statement responsible for storing some defined LABEL into some defined SR1"},
+    {STI_OP, "; STI statement responsible for storing some defined LABEL indirectly into some defined SR1"},
+    {STR_OP, "; STR statement responsible for storing some defined SR2 into some defined SR1, with some offset6"},
+    {TRAP_OP, "; TRAP statement responsible for invoking exiting syscall"},
+    {JMP_OP, "; JMP statement responsible for jumping to the address held in some BaseR"},
+    {JSR_OP, "; JSR statement responsible for saving the return address in R7 and calling some defined LABEL"},
+    {JSRR_OP, "; JSRR statement responsible for saving the return address in R7 and calling the address held in some BaseR"},
+    {RET_OP, "; RET statement responsible for returning to the address held in R7"},
+    {RTI_OP, "; RTI statement responsible for returning from an interrupt or trap routine"},
+    {INVALID_OP, "; NULL"},
+};
+
+const RegisterMap registerMap[] = {
+    {R0, "000"},
+    {R1, "001"},
+    {R2, "010"},
+    {R3, "011"},
+    {R4, "100"},
+    {R5, "101"},
+    {R6, "110"},
+    {R7, "111"},
+    {INVALID_REGISTER, "NULL"},
+};
+
+#include "utilities.h"
+#include "validations.h"
+#include "parsing.h"
+#include "symbols.h"
+#include "arena.h"
+#include "encoding.h"
+#include "output.h"
+#include "instructions.h"
+#include "assembler.h"
+#include "simulator.h"
+#include "jit.h"
+#include "disassembler.h"
+#include "incremental.h"
+#include "cache.h"
+#include "batch.h"
+#include "benchmarks.h"
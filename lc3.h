@@ -0,0 +1,788 @@
+#ifndef LC3_H
+#define LC3_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <ctype.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#define IMMEDIATE_SIZE_ADD_AND 5
+#define IMMEDIATE_SIZE_LDR_STR 6
+
+// Highest verbosity compiled in; build with -DLC3_MAX_VERBOSITY=0 to strip every diagnostic
+#ifndef LC3_MAX_VERBOSITY
+#define LC3_MAX_VERBOSITY 2
+#endif
+
+typedef enum {
+    VERBOSITY_QUIET,
+    VERBOSITY_ERRORS,
+    VERBOSITY_TRACE
+} Verbosity;
+
+// Per thread, so batch jobs and library callers running side by side keep their diagnostics apart
+extern _Thread_local Verbosity verbosity; // Batch workers start from the level of the thread that started them
+extern _Thread_local FILE *logStream; // stdout, stderr when stdout carries the assembled output, or a job's buffer
+extern _Thread_local int errorCount; // Errors reported by the job running on this thread
+
+#define LOG_ENABLED(level) (LC3_MAX_VERBOSITY >= (level) && verbosity >= (level))
+#define LOG_AT(level, ...) do { if (LOG_ENABLED(level)) fprintf(logStream, __VA_ARGS__); } while (0)
+#define LOG_ERROR(...) do { errorCount++; LOG_AT(VERBOSITY_ERRORS, __VA_ARGS__); } while (0)
+#define LOG_TRACE(...) LOG_AT(VERBOSITY_TRACE, __VA_ARGS__)
+
+typedef enum {
+    ADD, 
+    AND, 
+    BR,
+    LD,
+    LDI,
+    LDR,
+    LEA, 
+    NOT,
+    ST,
+    STI,
+    STR,
+    TRAP,
+    JMP,
+    JSR,
+    JSRR,
+    RET,
+    RTI,
+    GETC,
+    OUT,
+    PUTS,
+    IN,
+    PUTSP,
+    HALT,
+    ORIG,
+    END,
+    HASH,
+    LABEL,
+    SEMI,
+    BLKW,
+    FILL,
+    INVALID_TOKEN
+} Tokens;
+
+typedef enum {
+    ADD_ONE_OP,
+    ADD_TWO_OP,
+    AND_ONE_OP,
+    AND_TWO_OP,
+    BR_OP,
+    LD_OP,
+    LDI_OP,
+    LDR_OP,
+    LEA_OP,
+    NOT_OP,
+    ST_OP,
+    STI_OP,
+    STR_OP,
+    TRAP_OP,
+    JMP_OP,
+    JSR_OP,
+    JSRR_OP,
+    RET_OP,
+    RTI_OP,
+    INVALID_OP
+} BinOps;
+
+typedef struct {
+    BinOps binaryOps;
+    const char *opcode;
+    uint16_t opcodeBits;
+} InstructionMap;
+
+// Shared by every job, never written
+extern const InstructionMap instructionMap[];
+
+typedef struct {
+    BinOps binaryOps;
+    const char *comment;
+} CommentMap;
+
+// Shared by every job, never written
+extern const CommentMap commentMap[];
+
+typedef enum {
+    R0,
+    R1,
+    R2, 
+    R3, 
+    R4,
+    R5,
+    R6,
+    R7,
+    INVALID_REGISTER
+} RegisterTokens;
+
+typedef struct {
+    RegisterTokens regTok;
+    const char *binVal;
+} RegisterMap;
+
+// Shared by every job, never written
+extern const RegisterMap registerMap[];
+
+// Operand fields as the parsers read them; registers hold RegisterTokens values, which match the register numbers
+typedef struct {
+    int dr; // DR, or SR for the stores
+    int sr1; // SR1, SR or BaseR
+    int sr2;
+    int imm; // imm5, offset6, PCoffset9 or trapvect8, not yet masked
+    int conditions; // n/z/p bits for BR
+    bool immediate;
+} Operands;
+
+typedef enum {
+    FORMAT_LISTING,
+    FORMAT_OBJECT
+} OutputFormat;
+
+// Symbol files written next to the output, flags that can be combined
+typedef enum {
+    SYMBOLS_NONE = 0,
+    SYMBOLS_TABLE = 1, // Sorted binary table, .lsym
+    SYMBOLS_TEXT = 2 // Text listing, .sym
+} SymbolExport;
+
+#define LC3_MEMORY_WORDS 65536
+
+// The assembled words laid out at their addresses, so a program can be run without reading it back from a file
+typedef struct {
+    uint16_t words[LC3_MEMORY_WORDS];
+    uint16_t origin; // Where execution starts, the first .ORIG
+    bool originSet;
+    int cursor; // Address the next word goes to
+} MemoryImage;
+
+#define LC3_DEFAULT_CACHE_SIZE (256LL * 1024 * 1024)
+
+// A directory of assembled results keyed by source contents, shared by every job of a run
+typedef struct {
+    const char *directory;
+    long long sizeLimit; // Bytes; the least recently used entries go once it is passed
+    long long size; // Bytes in the directory as of the last scan, plus what was stored since
+    mode_t entryMode; // What the umask leaves of 0666, mkstemp alone would give 0600
+    int hits;
+    int misses;
+    int stores;
+    int evictions;
+    pthread_mutex_t lock;
+} AssemblyCache;
+
+// One cache entry as seen by the eviction scan
+typedef struct {
+    char *path;
+    long long size;
+    long long lastUsed; // Modification time, hits touch it
+} CachedFile;
+
+// One source to assemble and where its output goes
+typedef struct {
+    const char *inputPath; // - for stdin
+    const char *outputPath; // - for stdout
+    OutputFormat format;
+    bool singlePass;
+    MemoryImage *image; // Also receives the assembled words when not NULL
+    int symbolExport; // SymbolExport flags
+    AssemblyCache *cache; // Consulted by assembleJob when not NULL
+    int errors; // Set once the job has run
+} AssemblyJob;
+
+// How assemble treats one source held in memory
+typedef struct {
+    OutputFormat format;
+    bool singlePass;
+    Verbosity verbosity; // For this call on this thread, the caller's level is restored afterwards
+    MemoryImage *image; // Also receives the assembled words when not NULL
+} AssemblyOptions;
+
+// Batch mode: workers pull the next job index under the lock until none are left
+typedef struct {
+    AssemblyJob *jobs;
+    int jobCount;
+    int nextJob;
+    int failedJobs;
+    Verbosity verbosity; // Copied into every worker thread
+    pthread_mutex_t lock;
+} JobQueue;
+
+typedef enum {
+    ENTRY_ORIGIN,
+    ENTRY_INSTRUCTION,
+    ENTRY_FILL,
+    ENTRY_RESERVED,
+    ENTRY_STRING,
+    ENTRY_END
+} OutputEntryKind;
+
+// One emitted item, held back in single-pass mode until every label is known
+typedef struct {
+    OutputEntryKind kind;
+    uint16_t word; // Encoded word, .FILL value, .BLKW fill value or .ORIG address
+    int blockSize; // Words reserved by .BLKW, or characters in a .STRINGZ
+    const char *comment;
+    char *characters; // .STRINGZ text, owned by the entry
+} OutputEntry;
+
+#define OUTPUT_SINK_SIZE (256 * 1024)
+
+// A block buffer in front of a FILE, or of a file descriptor written with write/writev
+typedef struct {
+    FILE *file;
+    int fd; // Bypasses file when not -1
+    char *buffer;
+    size_t used;
+    size_t capacity;
+    bool failed; // A write failed, reported once
+} OutputSink;
+
+typedef struct {
+    OutputSink sink;
+    OutputFormat format;
+    bool originWritten;
+    bool deferred; // Collect entries instead of writing them, see flushOutputWriter
+    OutputEntry *entries;
+    int entryBase; // Number of the entry held in entries[0]
+    int entryCount;
+    int entryCapacity;
+    MemoryImage *image; // Every word written also lands here when not NULL
+} OutputWriter;
+
+typedef struct ArenaBlock {
+    struct ArenaBlock *next;
+    size_t size;
+    size_t used;
+    char data[];
+} ArenaBlock;
+
+typedef struct {
+    ArenaBlock *head;
+} Arena;
+
+typedef struct {
+    const char *label;
+    int lineNum;
+    int address;
+} LabelInfo;
+
+typedef struct {
+    Arena *names;
+    LabelInfo *entries;
+    int count;
+    int capacity;
+    int *buckets;
+    int bucketCount;
+} SymbolTable;
+
+// A binary symbol table file loaded as is, searched in place
+typedef struct {
+    unsigned char *data;
+    int count;
+    const unsigned char *records; // count records sorted by address
+    const char *names; // Null-terminated names the records point into
+} SymbolIndex;
+
+// A PC offset that could not be computed yet because its label comes later in the source
+typedef struct {
+    const char *label;
+    int entryIndex; // Output entry holding the instruction word to patch
+    int address; // Address of the instruction itself
+    int offsetBits;
+    int next; // Previous fixup for the same label, -1 at the end of the chain
+    bool resolved;
+} Fixup;
+
+typedef struct {
+    Fixup *entries;
+    int count;
+    int capacity;
+    int firstOpen; // Oldest fixup that may still be unresolved
+    SymbolTable pending; // Labels referenced before their definition
+} FixupList;
+
+#define LINE_READER_BLOCK_SIZE (64 * 1024)
+
+typedef struct {
+    FILE *file; // NULL when reading source that is already in memory
+    char *buffer;
+    size_t capacity;
+    size_t start; // First byte not handed out yet
+    size_t end; // One past the last byte read
+    bool eof;
+} LineReader;
+
+// A token that points into the source instead of being copied out of it
+typedef struct {
+    const char *start;
+    size_t length;
+} TokenView;
+
+// What the first pass takes from one line
+typedef struct {
+    const char *label; // Points into the line, NULL when it defines none
+    size_t labelLength;
+    int origin; // Where a .ORIG moves the location counter, -1 otherwise
+    int size; // Words the line occupies
+    bool ends; // .END, the first pass stops here
+} LineSummary;
+
+typedef struct {
+    const char *source;
+    int length;
+    int index;
+    Arena *scratch;
+} Lexer;
+
+// How an instruction's operands are written, which picks how they are parsed and checked
+typedef enum {
+    SHAPE_REG_REG_REG_OR_IMM5, // DR, SR1, SR2 | DR, SR1, #imm5
+    SHAPE_REG_REG, // DR, SR
+    SHAPE_REG_REG_OFFSET6, // DR/SR, BaseR, #offset6
+    SHAPE_REG_PCOFFSET9, // DR/SR, LABEL
+    SHAPE_BASE_REG, // BaseR
+    SHAPE_BRANCH, // BRnzp LABEL, the condition codes ride on the mnemonic
+    SHAPE_PCOFFSET11, // LABEL
+    SHAPE_TRAPVECT8, // xNN
+    SHAPE_NONE // Nothing to parse, any operand is implied
+} OperandShape;
+
+/*
+    One row per instruction, indexed by its Tokens value. Adding an opcode
+    means adding a row here; the generic path in instructions.h does the rest.
+*/
+typedef struct {
+    const char *mnemonic;
+    OperandShape shape;
+    BinOps registerForm; // The encoding, or the register form when there is also an immediate one
+    BinOps immediateForm; // INVALID_OP unless the last operand may be #imm5
+    const char *registerRole; // What the first register is called in errors, DR or SR
+    bool (*parseRegisterOperands)(Lexer *lexer, Operands *operands); // Register shapes, filling in the fields they use
+    bool (*parseLabelOperands)(Lexer *lexer, int *reg, char *targetLabel); // SHAPE_REG_PCOFFSET9
+    int impliedImmediate; // Trap vector of the TRAP aliases
+    const char *comment; // Listing comment when the BinOps one does not fit, NULL otherwise
+} InstructionDescriptor;
+
+// What the generic instruction path needs from the file being assembled
+typedef struct {
+    SymbolTable *symbols;
+    FixupList *fixups; // NULL unless assembling in a single pass
+    OutputWriter *writer;
+    Arena *scratch;
+    const char *referencedLabel; // Label of the last PC-relative operand parsed, lives in scratch
+} InstructionContext;
+
+/*
+    What assemble produced for the last source, plus everything it reuses
+    on the next call. bytes and diagnostics are only valid until then.
+*/
+typedef struct {
+    char *bytes; // The listing or object file
+    size_t length;
+    char *diagnostics; // What was logged, null-terminated
+    size_t diagnosticsLength;
+    int errors;
+    SymbolTable symbols; // Labels, named out of arena
+    FILE *outputStream; // Memory streams writing bytes and diagnostics
+    FILE *diagnosticStream;
+    Arena arena;
+    Arena scratch;
+    FixupList fixups;
+    OutputWriter writer;
+} AssemblyOutput;
+
+// One source line as the incremental engine last assembled it
+typedef struct {
+    char *text; // Own copy, newline included like nextLine hands it out
+    size_t length;
+    unsigned int hash;
+    LineSummary summary; // label points into text
+    int symbolIndex; // Entry in the engine's symbols the line's label got, -1 when none
+    int address; // Location counter the second pass started the line at
+    int nextAddress; // And where the line left it
+    bool absolute; // Has a .ORIG, so nextAddress does not move with address
+    OutputEntry *entries; // Everything the line emitted, in order
+    int entryCount;
+    char *referencedLabel; // PC-relative operand, NULL when the line has none
+    int targetIndex; // Entry referencedLabel resolved to, -1 while it is undefined
+    int offset; // referencedLabel's address minus address when encoded, INT_MIN while undefined
+    char *diagnostics; // What the second pass logged for the line
+    size_t diagnosticsLength;
+    int errors;
+    bool duplicateLabel; // Set when the symbols are laid out
+} AssembledLine;
+
+/*
+    Keeps a file's lines, symbols and encoded words between edits. After
+    an edit, changedLines lists every line whose words or address changed.
+*/
+typedef struct {
+    AssembledLine *lines;
+    int lineCount;
+    int lineCapacity;
+    Arena names; // Label names, reset whenever the symbols are laid out again
+    SymbolTable symbols;
+    int lineErrors; // Second pass errors over all lines
+    int duplicateLabels;
+    int *changedLines;
+    int changedCount;
+    int changedCapacity;
+    int relexedLines; // What the last edit had to redo
+    int reassembledLines;
+    double milliseconds;
+} AssemblyEngine;
+
+// The hardware opcode in bits 15-12 of an instruction word
+typedef enum {
+    OPCODE_BR,
+    OPCODE_ADD,
+    OPCODE_LD,
+    OPCODE_ST,
+    OPCODE_JSR,
+    OPCODE_AND,
+    OPCODE_LDR,
+    OPCODE_STR,
+    OPCODE_RTI,
+    OPCODE_NOT,
+    OPCODE_LDI,
+    OPCODE_STI,
+    OPCODE_JMP,
+    OPCODE_RESERVED,
+    OPCODE_LEA,
+    OPCODE_TRAP
+} Opcode;
+
+// An instruction word split into its fields once, so running it never has to pick bits apart again
+typedef struct {
+    uint8_t opcode;
+    uint8_t dr; // DR, SR for the stores, n/z/p for BR
+    uint8_t sr1; // SR1 or BaseR
+    uint8_t sr2;
+    bool immediate; // imm5 form of ADD/AND, PCoffset11 form of JSR
+    int16_t offset; // imm5, offset6, PCoffset9 or PCoffset11 sign-extended, or trapvect8
+} DecodedInstruction;
+
+#define CONDITION_N 4
+#define CONDITION_Z 2
+#define CONDITION_P 1
+
+#define LC3_DEFAULT_INSTRUCTION_LIMIT 100000000LL
+
+// Threaded dispatch needs labels as values; build with -DLC3_NO_COMPUTED_GOTO to get the switch everywhere
+#if defined(__GNUC__) && !defined(LC3_NO_COMPUTED_GOTO)
+#define LC3_THREADED_DISPATCH 1
+#else
+#define LC3_THREADED_DISPATCH 0
+#endif
+
+// Native code for hot blocks needs x86-64 and mmap; build with -DLC3_NO_JIT to leave it out
+#if defined(__x86_64__) && (defined(__linux__) || defined(__APPLE__)) && !defined(LC3_NO_JIT)
+#define LC3_JIT_AVAILABLE 1
+#else
+#define LC3_JIT_AVAILABLE 0
+#endif
+
+typedef enum {
+    DISPATCH_SWITCH, // One central switch on the decoded opcode
+    DISPATCH_THREADED, // Every word carries its handler's address, falls back to the switch without computed goto
+    DISPATCH_JIT // Hot blocks run as x86-64 code, the rest interpreted; falls back to threaded without a JIT
+} DispatchMode;
+
+typedef enum {
+    RUN_RUNNING,
+    RUN_HALTED, // HALT trap
+    RUN_LIMIT, // Instruction limit reached first
+    RUN_FAULT // Illegal opcode, RTI or an unknown trap
+} RunResult;
+
+typedef struct Machine {
+    uint16_t memory[LC3_MEMORY_WORDS];
+    DecodedInstruction decoded[LC3_MEMORY_WORDS]; // Kept in step with memory on every store
+#if LC3_THREADED_DISPATCH
+    const void *threaded[LC3_MEMORY_WORDS]; // Handler for each word, filled in by runThreaded
+#endif
+    uint16_t registers[8];
+    uint16_t pc;
+    uint8_t conditions; // One of CONDITION_N, CONDITION_Z, CONDITION_P
+    long long executed;
+    FILE *input; // GETC and IN
+    FILE *output; // OUT, PUTS, PUTSP and IN
+    struct JitState *jit; // For stores from compiled code, NULL unless running under runJit
+} Machine;
+
+#define JIT_BUFFER_SIZE (4 * 1024 * 1024)
+#define JIT_MAX_BLOCK_LENGTH 64
+#define JIT_MAX_BLOCK_BYTES (JIT_MAX_BLOCK_LENGTH * 64 + 64)
+#define JIT_DEFAULT_THRESHOLD 16
+
+// A compiled block returns the next PC in the low 16 bits and the instructions it ran above them
+typedef uint32_t (*JitBlockFunction)(Machine *machine);
+
+typedef struct {
+    JitBlockFunction code; // NULL when no live block starts at this address
+    int length; // Instructions in the block, one word each
+} JitBlock;
+
+typedef struct JitState {
+    unsigned char *buffer; // mmap'd read/write/execute
+    size_t capacity;
+    size_t used;
+    JitBlock blocks[LC3_MEMORY_WORDS]; // By start address
+    uint8_t coverage[LC3_MEMORY_WORDS]; // Live blocks that include each word
+    uint16_t heat[LC3_MEMORY_WORDS]; // Times each address was interpreted since its last compile attempt
+    int threshold; // Interpretations before an address gets compiled
+    long long compiledBlocks;
+    long long droppedBlocks;
+} JitState;
+
+// One row of the disassembler's decode table, there is one for every possible word
+typedef struct {
+    char text[24]; // Mnemonic and every operand that does not depend on where the word sits
+    uint8_t length;
+    uint8_t targetBits; // 9 or 11 when a PC-relative label follows the text, 0 otherwise
+} DisassemblyEntry;
+
+typedef struct {
+    DisassemblyEntry entries[LC3_MEMORY_WORDS];
+    const InstructionDescriptor *descriptors[INVALID_OP + 1]; // By encoding, NULL for INVALID_OP
+    const InstructionDescriptor *trapDescriptors[256]; // By trap vector, the alias when there is one
+} DisassemblyTable;
+
+void initLexer(Lexer *lexer, const char *source, size_t length, Arena *scratch);
+char *allocTokenBuffer(Lexer *lexer);
+void initBufferReader(LineReader *reader, const char *source, size_t length);
+void initStreamReader(LineReader *reader, FILE *file);
+void rewindLineReader(LineReader *reader);
+void freeLineReader(LineReader *reader);
+bool nextLine(LineReader *reader, const char **line, size_t *lineLength);
+const char *mapInputFile(FILE *file, size_t *length);
+void unmapInputFile(const char *source, size_t length);
+bool nextTokenView(const char *line, size_t length, size_t *position, TokenView *token);
+bool viewEquals(TokenView token, const char *text);
+int viewToInt(TokenView token, int base);
+char peek(Lexer *lexer, int offset);
+char consume(Lexer *lexer);
+Tokens validateTokenView(const char *token, size_t length);
+Tokens validateToken(const char *token);
+RegisterTokens validateRegisterToken(const char *regstr);
+bool isRegister(char *token);
+bool isSoloLabel(const char* token);
+bool isImm5(char *imm5);
+bool isValidBranchCondition(char condition);
+LabelInfo *lookupLabel(const char *label, SymbolTable *symbols);
+bool isLabelDefinition(char *token);
+bool isInstructionOrDirective(const char *token);
+bool isInstructionOrDirectiveView(TokenView token);
+bool isSoloLabelView(TokenView token);
+bool isValidTrapVector(const char *offset);
+
+TokenView scanOperand(Lexer *lexer);
+bool registerFromView(TokenView token, int *reg);
+bool immediateFromView(TokenView token, int *value);
+bool registerOrImmediateFromView(TokenView token, Operands *operands);
+bool parseORIG(Lexer *lexer, unsigned int *address);
+bool parseADD(Lexer *lexer, Operands *operands);
+bool parseAND(Lexer *lexer, Operands *operands);
+bool parseBR(Lexer *lexer, char *targetLabel);
+bool isBRInstruction(char *token);
+bool parseLD(Lexer *lexer, int *dr, char *targetLabel);
+bool parseLDI(Lexer *lexer, int *dr, char *targetLabel);
+bool parseLDR(Lexer *lexer, Operands *operands);
+bool parseLEA(Lexer *lexer, int *dr, char *targetLabel);
+bool parseNOT(Lexer *lexer, Operands *operands);
+bool parseST(Lexer *lexer, int *sr, char *targetLabel);
+bool parseSTI(Lexer *lexer, int *sr, char *targetLabel);
+bool parseSTR(Lexer *lexer, Operands *operands);
+bool parseTRAP(Lexer *lexer, int *trapVector);
+bool parseJMP(Lexer *lexer, Operands *operands);
+bool parseJSR(Lexer *lexer, char *targetLabel);
+bool parseJSRR(Lexer *lexer, Operands *operands);
+bool parseSEMI(Lexer *lexer);
+bool parseFILL(Lexer *lexer, int *immValue);
+bool parseEND(Lexer *lexer);
+bool parseBLKW(Lexer *lexer, int *blockSize, int *fillValue);
+bool parseSTRINGZ(Lexer *lexer, char *charactersOut, int *length);
+
+const char *getOpcodeForToken(BinOps binaryOps);
+const char *getBinValForRegister(RegisterTokens regTok);
+const char *getCommentForInstruction(BinOps binaryOps);
+int decodeStringLiteral(const char *text, size_t length, size_t *position, char *out);
+int calculateOffset(const LabelInfo *target, int currentAddress, int offsetBits);
+double monotonicSeconds(void);
+
+void initSymbolTable(SymbolTable *symbols, Arena *names);
+void freeSymbolTable(SymbolTable *symbols);
+void clearSymbolTable(SymbolTable *symbols);
+unsigned int hashLabel(const char *label, size_t length);
+void rehashSymbolTable(SymbolTable *symbols, int bucketCount);
+LabelInfo *findSymbolView(SymbolTable *symbols, const char *label, size_t length);
+LabelInfo *findSymbol(SymbolTable *symbols, const char *label);
+bool addLabel(SymbolTable *symbols, const char *label, size_t length, int lineNum, int address);
+void initFixupList(FixupList *fixups, Arena *names);
+void freeFixupList(FixupList *fixups);
+void clearFixupList(FixupList *fixups);
+void addFixup(FixupList *fixups, const char *label, int entryIndex, int address, int offsetBits);
+bool resolveLabelOffset(SymbolTable *symbols, FixupList *fixups, OutputWriter *writer, const char *label, int currentAddress, int offsetBits, int *offset);
+void resolveFixups(FixupList *fixups, const LabelInfo *target, OutputWriter *writer);
+int firstOpenFixupEntry(const FixupList *fixups);
+void reportUnresolvedFixups(const FixupList *fixups);
+char *symbolPathFor(const char *objectPath, const char *extension);
+void storeBigEndian(unsigned char *bytes, uint32_t value, int size);
+uint32_t loadBigEndian(const unsigned char *bytes, int size);
+int compareSymbolsByAddress(const void *a, const void *b);
+const LabelInfo **sortSymbolsByAddress(const SymbolTable *symbols);
+bool writeSymbolTableFile(const LabelInfo **sorted, int count, const char *path);
+bool writeSymbolTextFile(const LabelInfo **sorted, int count, const char *path);
+bool exportSymbols(const SymbolTable *symbols, const char *outputPath, int symbolExport);
+bool loadSymbolIndex(const char *path, SymbolIndex *index);
+void freeSymbolIndex(SymbolIndex *index);
+uint16_t symbolIndexAddress(const SymbolIndex *index, int position);
+const char *symbolIndexName(const SymbolIndex *index, int position);
+int findSymbolAtAddress(const SymbolIndex *index, uint16_t address);
+
+void initArena(Arena *arena);
+void *arenaAlloc(Arena *arena, size_t size);
+char *arenaStrndup(Arena *arena, const char *source, size_t length);
+void arenaReset(Arena *arena);
+void freeArena(Arena *arena);
+char *arenaReadFile(Arena *arena, FILE *file, size_t *length);
+
+bool fitsInBits(int value, int bits);
+uint16_t encodeInstruction(BinOps binaryOps, const Operands *operands);
+void wordToBinary(uint16_t word, char *binaryOut);
+
+void initOutputWriter(OutputWriter *writer, FILE *file, OutputFormat format);
+void freeOutputWriter(OutputWriter *writer);
+void resetOutputWriter(OutputWriter *writer, OutputFormat format);
+void initOutputSink(OutputSink *sink, FILE *file);
+void setOutputDescriptor(OutputSink *sink, int fd);
+bool writeOutputVectors(OutputSink *sink, struct iovec *vectors, int count);
+void drainOutputSink(OutputSink *sink, const void *extra, size_t extraLength);
+void flushOutputSink(OutputSink *sink);
+void freeOutputSink(OutputSink *sink);
+char *reserveOutput(OutputSink *sink, size_t length);
+void writeOutput(OutputSink *sink, const void *data, size_t length);
+void writeOutputText(OutputSink *sink, const char *text);
+void writeBigEndianWord(uint16_t word, OutputSink *sink);
+OutputEntry *appendOutputEntry(OutputWriter *writer, OutputEntryKind kind);
+void patchOutputEntry(OutputWriter *writer, int entryIndex, uint16_t mask, uint16_t bits);
+void replayOutputEntry(OutputWriter *writer, const OutputEntry *entry);
+void flushOutputWriter(OutputWriter *writer, int limit);
+void emitOrigin(OutputWriter *writer, uint16_t address);
+void emitInstruction(OutputWriter *writer, uint16_t word, const char *comment);
+void emitFill(OutputWriter *writer, uint16_t value);
+void emitReserved(OutputWriter *writer, int blockSize, uint16_t fillValue);
+void emitString(OutputWriter *writer, const char *characters, int length);
+void emitEnd(OutputWriter *writer);
+void initMemoryImage(MemoryImage *image);
+void storeImageWord(MemoryImage *image, uint16_t word);
+
+bool isInstructionToken(Tokens token);
+void emitPlaceholderWord(OutputWriter *writer);
+bool assembleInstruction(const InstructionDescriptor *descriptor, const char *mnemonic, Lexer *lexer, InstructionContext *context, int currentAddress);
+void summarizeLine(const char *sourceLine, size_t sourceLineLength, LineSummary *summary);
+int assembleLine(InstructionContext *context, const char *sourceLine, size_t sourceLineLength, int lineNum, int currentAddress);
+void assembleLines(LineReader *reader, InstructionContext *context, bool singlePass);
+bool assembleFile(AssemblyJob *job);
+bool initAssemblyOutput(AssemblyOutput *output);
+void freeAssemblyOutput(AssemblyOutput *output);
+bool assemble(const char *source, size_t length, AssemblyOptions options, AssemblyOutput *output);
+void initAssemblyEngine(AssemblyEngine *engine);
+void freeAssembledLine(AssembledLine *line);
+void freeAssemblyEngine(AssemblyEngine *engine);
+int engineErrors(const AssemblyEngine *engine);
+void initAssembledLine(AssembledLine *line, const char *text, size_t length, unsigned int hash);
+bool sameLineText(const AssembledLine *line, TokenView text, unsigned int hash);
+bool affectsLayout(const LineSummary *summary);
+void noteChangedLine(AssemblyEngine *engine, int index);
+void layoutEngineSymbols(AssemblyEngine *engine);
+bool shiftEngineSymbols(AssemblyEngine *engine, int firstLine, int sizeChange);
+void resolveEngineTarget(AssemblyEngine *engine, AssembledLine *line);
+int engineOffset(const AssemblyEngine *engine, const AssembledLine *line, int address);
+void reassembleLine(AssemblyEngine *engine, int index, int address, InstructionContext *context, FILE *log, char **logText, size_t *logLength);
+void editAssemblyEngine(AssemblyEngine *engine, int firstLine, int removedLines, const char *text, size_t length);
+void loadAssemblyEngine(AssemblyEngine *engine, const char *source, size_t length);
+void writeAssemblyEngine(const AssemblyEngine *engine, OutputWriter *writer);
+void writeAssemblyEngineDiagnostics(const AssemblyEngine *engine, FILE *file);
+int16_t signExtend(uint16_t value, int bits);
+DecodedInstruction decodeWord(uint16_t word);
+void loadMachine(Machine *machine, const MemoryImage *image, FILE *input, FILE *output);
+void storeMachineWord(Machine *machine, uint16_t address, uint16_t value);
+void setConditions(Machine *machine, uint16_t value);
+RunResult executeTrap(Machine *machine, int trapVector);
+RunResult runMachine(Machine *machine, long long instructionLimit);
+RunResult runThreaded(Machine *machine, long long instructionLimit);
+RunResult runProgram(Machine *machine, DispatchMode dispatch, long long instructionLimit);
+bool initJit(JitState *jit, int threshold);
+void freeJit(JitState *jit);
+void flushJit(JitState *jit);
+void dropJitBlock(JitState *jit, int start);
+void invalidateJitWord(JitState *jit, uint16_t address);
+uint32_t jitStore(Machine *machine, uint32_t address, uint32_t value);
+int storeTarget(const Machine *machine, const DecodedInstruction *instruction);
+bool isJitCompilable(const DecodedInstruction *instruction);
+bool endsJitBlock(const DecodedInstruction *instruction);
+void jitCode(JitState *jit, const uint8_t *bytes, int count);
+void jitImm32(JitState *jit, uint32_t value);
+void jitLoadRegister(JitState *jit, int x86Register, int lc3Register);
+void jitStoreRegister(JitState *jit, int lc3Register);
+void jitLoadMemory(JitState *jit);
+void jitSetConditions(JitState *jit);
+void jitExit(JitState *jit, uint16_t nextPc, int count);
+void jitCallStore(JitState *jit, uint16_t nextPc, int count);
+bool compileJitBlock(JitState *jit, Machine *machine, uint16_t start);
+RunResult runJit(Machine *machine, JitState *jit, long long instructionLimit);
+BinOps binOpForWord(uint16_t word);
+const InstructionDescriptor *descriptorForBinOp(BinOps binaryOps, int trapVector);
+void appendRegisterName(char *text, int *length, int reg);
+void appendDecimal(char *text, int *length, int value);
+void appendHex(char *text, int *length, unsigned int value, int digits);
+void buildDisassemblyEntry(const DisassemblyTable *table, uint16_t word, DisassemblyEntry *entry);
+void buildDisassemblyTable(DisassemblyTable *table);
+bool readObjectFile(const char *path, MemoryImage *image, int *wordCount);
+int readSymbolFile(const char *path, Arena *names, const char **labelAt);
+void flushDisassembly(FILE *file, char *buffer, size_t *used);
+bool disassembleFile(const char *inputPath, const char *symbolPath, const char *outputPath);
+char *outputPathFor(const char *inputPath, OutputFormat format);
+bool addBatchJob(AssemblyJob **jobs, int *jobCount, int *capacity, const char *inputPath, OutputFormat format, bool singlePass);
+bool collectBatchJobs(const char *batchPath, OutputFormat format, bool singlePass, AssemblyJob **jobs, int *jobCount);
+void *batchWorker(void *arg);
+bool runBatch(const char *batchPath, OutputFormat format, bool singlePass, int symbolExport, AssemblyCache *cache, int threadCount);
+uint64_t hashBytes64(const void *data, size_t length, uint64_t seed);
+char *cacheEntryPath(const AssemblyCache *cache, uint64_t key);
+bool isCacheEntryName(const char *name);
+int compareCachedFiles(const void *a, const void *b);
+long long pruneCacheDirectory(AssemblyCache *cache, long long limit);
+bool initAssemblyCache(AssemblyCache *cache, const char *directory, long long sizeLimit);
+void freeAssemblyCache(AssemblyCache *cache);
+void reportAssemblyCache(const AssemblyCache *cache);
+uint64_t cacheKeyFor(const AssemblyJob *job, const char *source, size_t sourceLength);
+bool writeWholeFile(const char *path, const char *data, size_t length);
+const char *readWholeFile(Arena *arena, const char *path, size_t *length);
+bool loadCachedAssembly(AssemblyCache *cache, AssemblyJob *job, uint64_t key, size_t sourceLength);
+void storeCachedAssembly(AssemblyCache *cache, const AssemblyJob *job, uint64_t key, size_t sourceLength, const char *diagnostics, size_t diagnosticsLength);
+bool assembleJob(AssemblyJob *job);
+Tokens validateTokenChain(const char *token);
+RegisterTokens validateRegisterTokenChain(const char *regstr);
+void runClassifierBenchmark(void);
+void benchInstruction(MemoryImage *image, BinOps binaryOps, int dr, int sr1, int operand);
+void buildLoopAddProgram(MemoryImage *image, int outerCount, int innerCount);
+void buildGeneratedLoopProgram(MemoryImage *image, int bodyLength, int iterations, unsigned int seed);
+void runSimulatorBenchmark(void);
+unsigned int nextRandom(unsigned int *seed);
+void buildRandomProgram(MemoryImage *image, unsigned int seed);
+bool sameMachineState(const Machine *a, const Machine *b);
+bool runJitSelfCheck(int programCount);
+char *renderAssemblyEngine(const AssemblyEngine *engine, bool diagnostics, size_t *length);
+bool sameRendering(const AssemblyEngine *a, const AssemblyEngine *b, bool diagnostics);
+bool runIncrementalSelfCheck(const char *path, int editCount);
+bool runDisassemblerSelfCheck(int objectCount);
+bool runSymbolIndexSelfCheck(int tableCount);
+
+#endif
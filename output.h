@@ -0,0 +1,563 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+/*
+    Everything the second pass produces goes through an OutputWriter.
+    FORMAT_LISTING keeps the original text form (one line of bits and a
+    comment per word), FORMAT_OBJECT writes the standard LC-3 object file:
+    the origin word followed by every word, all big-endian.
+
+    A deferred writer (single-pass mode) holds entries in memory so forward
+    references can be patched, and writes them in flushOutputWriter once no
+    unresolved reference precedes them. Entry numbers are absolute, entries[0]
+    is entry number entryBase.
+*/
+/*
+    All output goes through one OutputSink: a large buffer that text and
+    words are rendered into in place and that goes out in whole blocks.
+    By default a full buffer is handed to fwrite on the FILE. Once
+    setOutputDescriptor gives it a file descriptor, the sink bypasses stdio
+    and calls write(2). When a large run does not fit behind what is
+    buffered, it sends both with a single writev. The buffer is allocated on
+    the first write, so a writer that only ever defers costs nothing.
+*/
+void initOutputSink(OutputSink *sink, FILE *file)
+{
+    sink->file = file;
+    sink->fd = -1;
+    sink->buffer = NULL;
+    sink->used = 0;
+    sink->capacity = 0;
+    sink->failed = false;
+}
+
+// Writes straight to fd from now on; whatever stdio still holds for the FILE goes first
+void setOutputDescriptor(OutputSink *sink, int fd)
+{
+    if (sink->file != NULL)
+    {
+        fflush(sink->file);
+    }
+    sink->fd = fd;
+}
+
+// Writes every byte of the vectors, continuing after partial writes and interrupts
+bool writeOutputVectors(OutputSink *sink, struct iovec *vectors, int count)
+{
+    while (count > 0)
+    {
+        ssize_t written = writev(sink->fd, vectors, count);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return false;
+        }
+        while (count > 0 && (size_t)written >= vectors->iov_len)
+        {
+            written -= vectors->iov_len;
+            vectors++;
+            count--;
+        }
+        if (count > 0)
+        {
+            vectors->iov_base = (char *)vectors->iov_base + written;
+            vectors->iov_len -= written;
+        }
+    }
+    return true;
+}
+
+// Sends what is buffered followed by extra, which may be NULL; the buffer is empty afterwards
+void drainOutputSink(OutputSink *sink, const void *extra, size_t extraLength)
+{
+    bool written;
+    if (sink->fd >= 0)
+    {
+        struct iovec vectors[2] = {
+            { sink->buffer, sink->used },
+            { (void *)extra, extraLength }
+        };
+        written = writeOutputVectors(sink, vectors, extraLength > 0 ? 2 : 1);
+    }
+    else
+    {
+        // Empty parts are skipped, the buffer may not exist yet and extra may be NULL
+        written = (sink->used == 0 || fwrite(sink->buffer, 1, sink->used, sink->file) == sink->used)
+            && (extraLength == 0 || fwrite(extra, 1, extraLength, sink->file) == extraLength);
+    }
+    if (!written && !sink->failed)
+    {
+        sink->failed = true;
+        LOG_ERROR("Error writing output: %s\n", strerror(errno));
+    }
+    sink->used = 0;
+}
+
+void flushOutputSink(OutputSink *sink)
+{
+    if (sink->used > 0)
+    {
+        drainOutputSink(sink, NULL, 0);
+    }
+}
+
+void freeOutputSink(OutputSink *sink)
+{
+    flushOutputSink(sink);
+    free(sink->buffer);
+    sink->buffer = NULL;
+    sink->capacity = 0;
+}
+
+/*
+    Room for length more bytes at the end of the buffer, flushing it first
+    if they do not fit. The caller renders into it and then adds what it
+    actually wrote to sink->used.
+*/
+char *reserveOutput(OutputSink *sink, size_t length)
+{
+    if (sink->capacity - sink->used < length)
+    {
+        flushOutputSink(sink);
+    }
+    if (sink->capacity < length || sink->buffer == NULL)
+    {
+        size_t capacity = length > OUTPUT_SINK_SIZE ? length : OUTPUT_SINK_SIZE;
+        char *buffer = (char *)realloc(sink->buffer, capacity);
+        if (!buffer)
+        {
+            fprintf(stderr, "Memory allocation failed.\n");
+            exit(EXIT_FAILURE);
+        }
+        sink->buffer = buffer;
+        sink->capacity = capacity;
+    }
+    return sink->buffer + sink->used;
+}
+
+void writeOutput(OutputSink *sink, const void *data, size_t length)
+{
+    if (sink->buffer != NULL && sink->capacity - sink->used >= length)
+    {
+        memcpy(sink->buffer + sink->used, data, length);
+        sink->used += length;
+    }
+    else if (length >= OUTPUT_SINK_SIZE)
+    {
+        drainOutputSink(sink, data, length); // Too big to be worth copying, goes out together with the buffer
+    }
+    else
+    {
+        memcpy(reserveOutput(sink, length), data, length);
+        sink->used += length;
+    }
+}
+
+void writeOutputText(OutputSink *sink, const char *text)
+{
+    writeOutput(sink, text, strlen(text));
+}
+
+void initOutputWriter(OutputWriter *writer, FILE *file, OutputFormat format)
+{
+    initOutputSink(&writer->sink, file);
+    writer->format = format;
+    writer->originWritten = false;
+    writer->deferred = false;
+    writer->entries = NULL;
+    writer->entryBase = 0;
+    writer->entryCount = 0;
+    writer->entryCapacity = 0;
+    writer->image = NULL;
+}
+
+// Starts the writer over for another source, keeping its entry array and its sink
+void resetOutputWriter(OutputWriter *writer, OutputFormat format)
+{
+    int i;
+    for (i = 0; i < writer->entryCount; i++)
+    {
+        free(writer->entries[i].characters);
+    }
+    writer->sink.failed = false;
+    writer->format = format;
+    writer->originWritten = false;
+    writer->deferred = false;
+    writer->entryBase = 0;
+    writer->entryCount = 0;
+    writer->image = NULL;
+}
+
+// Flushes what the sink still holds, then frees the writer
+void freeOutputWriter(OutputWriter *writer)
+{
+    freeOutputSink(&writer->sink);
+    int i;
+    for (i = 0; i < writer->entryCount; i++)
+    {
+        free(writer->entries[i].characters);
+    }
+    free(writer->entries);
+    writer->entries = NULL;
+    writer->entryCount = 0;
+    writer->entryCapacity = 0;
+}
+
+void writeBigEndianWord(uint16_t word, OutputSink *sink)
+{
+    unsigned char *bytes = (unsigned char *)reserveOutput(sink, 2);
+    bytes[0] = (unsigned char)(word >> 8);
+    bytes[1] = (unsigned char)(word & 0xFF);
+    sink->used += 2;
+}
+
+void initMemoryImage(MemoryImage *image)
+{
+    memset(image->words, 0, sizeof(image->words));
+    image->origin = 0;
+    image->originSet = false;
+    image->cursor = 0;
+}
+
+// Addresses wrap around the 16-bit space the same way the location counter does
+void storeImageWord(MemoryImage *image, uint16_t word)
+{
+    image->words[image->cursor & 0xFFFF] = word;
+    image->cursor = (image->cursor + 1) & 0xFFFF;
+}
+
+OutputEntry *appendOutputEntry(OutputWriter *writer, OutputEntryKind kind)
+{
+    if (writer->entryCount == writer->entryCapacity)
+    {
+        int capacity = writer->entryCapacity ? writer->entryCapacity * 2 : 256;
+        OutputEntry *entries = (OutputEntry *)realloc(writer->entries, capacity * sizeof(OutputEntry));
+        if (!entries)
+        {
+            fprintf(stderr, "Memory allocation failed.\n");
+            exit(EXIT_FAILURE);
+        }
+        writer->entries = entries;
+        writer->entryCapacity = capacity;
+    }
+
+    OutputEntry *entry = &writer->entries[writer->entryCount++];
+    entry->kind = kind;
+    entry->word = 0;
+    entry->blockSize = 0;
+    entry->comment = NULL;
+    entry->characters = NULL;
+    return entry;
+}
+
+// Overwrites the masked bits of an instruction word that is still held back
+void patchOutputEntry(OutputWriter *writer, int entryIndex, uint16_t mask, uint16_t bits)
+{
+    OutputEntry *entry = &writer->entries[entryIndex - writer->entryBase];
+    entry->word = (uint16_t)((entry->word & ~mask) | (bits & mask));
+}
+
+void emitOrigin(OutputWriter *writer, uint16_t address)
+{
+    if (writer->deferred)
+    {
+        appendOutputEntry(writer, ENTRY_ORIGIN)->word = address;
+        return;
+    }
+
+    if (writer->image != NULL)
+    {
+        if (!writer->image->originSet)
+        {
+            writer->image->origin = address;
+            writer->image->originSet = true;
+        }
+        writer->image->cursor = address;
+    }
+
+    if (writer->format == FORMAT_OBJECT)
+    {
+        if (writer->originWritten)
+        {
+            LOG_ERROR("Only one .ORIG is supported in an object file, ignoring x%04X.\n", address);
+            return;
+        }
+        writeBigEndianWord(address, &writer->sink);
+    }
+    else
+    {
+        char *line = reserveOutput(&writer->sink, 23);
+        memcpy(line, ".ORIG ", 6);
+        wordToBinary(address, line + 6);
+        line[22] = '\n';
+        writer->sink.used += 23;
+    }
+    writer->originWritten = true;
+}
+
+void emitInstruction(OutputWriter *writer, uint16_t word, const char *comment)
+{
+    if (writer->deferred)
+    {
+        OutputEntry *entry = appendOutputEntry(writer, ENTRY_INSTRUCTION);
+        entry->word = word;
+        entry->comment = comment;
+        return;
+    }
+
+    if (writer->image != NULL)
+    {
+        storeImageWord(writer->image, word);
+    }
+
+    if (writer->format == FORMAT_OBJECT)
+    {
+        writeBigEndianWord(word, &writer->sink);
+        return;
+    }
+
+    // The bits, a space and the comment, rendered straight into the sink
+    size_t commentLength = strlen(comment);
+    char *line = reserveOutput(&writer->sink, 16 + 1 + commentLength + 1);
+    wordToBinary(word, line);
+    line[16] = ' ';
+    memcpy(line + 17, comment, commentLength);
+    line[17 + commentLength] = '\n';
+    writer->sink.used += 16 + 1 + commentLength + 1;
+}
+
+void emitFill(OutputWriter *writer, uint16_t value)
+{
+    if (writer->deferred)
+    {
+        appendOutputEntry(writer, ENTRY_FILL)->word = value;
+        return;
+    }
+
+    if (writer->image != NULL)
+    {
+        storeImageWord(writer->image, value);
+    }
+
+    if (writer->format == FORMAT_OBJECT)
+    {
+        writeBigEndianWord(value, &writer->sink);
+        return;
+    }
+
+    char *line = reserveOutput(&writer->sink, 23);
+    memcpy(line, ".FILL ", 6);
+    wordToBinary(value, line + 6);
+    line[22] = '\n';
+    writer->sink.used += 23;
+}
+
+/*
+    A .BLKW is one run of identical words. The listing gets a single summary
+    line however large the block is; the object file gets the run filled in
+    directly in the sink's buffer, as much as fits each time.
+*/
+void emitReserved(OutputWriter *writer, int blockSize, uint16_t fillValue)
+{
+    if (writer->deferred)
+    {
+        OutputEntry *entry = appendOutputEntry(writer, ENTRY_RESERVED);
+        entry->blockSize = blockSize;
+        entry->word = fillValue;
+        return;
+    }
+
+    if (writer->image != NULL)
+    {
+        int i;
+        for (i = 0; i < blockSize; i++)
+        {
+            storeImageWord(writer->image, fillValue);
+        }
+    }
+
+    OutputSink *sink = &writer->sink;
+    if (writer->format == FORMAT_LISTING)
+    {
+        // "; .BLKW ", at most 10 digits, " words of ", 16 bits and the newline
+        char *line = reserveOutput(sink, 48);
+        int length = sprintf(line, "; .BLKW %d word%s of ", blockSize, blockSize == 1 ? "" : "s");
+        wordToBinary(fillValue, line + length);
+        line[length + 16] = '\n';
+        sink->used += length + 17;
+        return;
+    }
+
+    int remaining = blockSize;
+    while (remaining > 0)
+    {
+        unsigned char *bytes = (unsigned char *)reserveOutput(sink, 2);
+        int room = (int)((sink->capacity - sink->used) / 2);
+        int words = remaining < room ? remaining : room;
+        int i;
+        for (i = 0; i < words; i++)
+        {
+            bytes[i * 2] = (unsigned char)(fillValue >> 8);
+            bytes[i * 2 + 1] = (unsigned char)(fillValue & 0xFF);
+        }
+        sink->used += words * 2;
+        remaining -= words;
+    }
+}
+
+/*
+    A whole .STRINGZ (characters plus the zero terminator) is rendered
+    straight into the sink, in either format.
+*/
+void emitString(OutputWriter *writer, const char *characters, int length)
+{
+    if (writer->deferred)
+    {
+        OutputEntry *entry = appendOutputEntry(writer, ENTRY_STRING);
+        entry->blockSize = length;
+        entry->characters = (char *)malloc(length > 0 ? length : 1);
+        if (!entry->characters)
+        {
+            fprintf(stderr, "Memory allocation failed.\n");
+            exit(EXIT_FAILURE);
+        }
+        memcpy(entry->characters, characters, length);
+        return;
+    }
+
+    if (writer->image != NULL)
+    {
+        int i;
+        for (i = 0; i < length; i++)
+        {
+            storeImageWord(writer->image, (unsigned char)characters[i]);
+        }
+        storeImageWord(writer->image, 0);
+    }
+
+    OutputSink *sink = &writer->sink;
+    int i;
+    if (writer->format == FORMAT_OBJECT)
+    {
+        for (i = 0; i <= length; i++)
+        {
+            writeBigEndianWord(i < length ? (unsigned char)characters[i] : 0, sink);
+        }
+        return;
+    }
+
+    // 16 bits, then at most " ; .STRINGZ character x00" and a newline per word
+    for (i = 0; i <= length; i++)
+    {
+        unsigned char ch = i < length ? (unsigned char)characters[i] : 0;
+        char *line = reserveOutput(sink, 16 + 32);
+        wordToBinary(ch, line);
+        int used = 16;
+        if (i == length)
+        {
+            used += sprintf(line + used, " ; .STRINGZ terminator\n");
+        }
+        else if (isprint(ch) && ch != '\'')
+        {
+            used += sprintf(line + used, " ; .STRINGZ character '%c'\n", ch);
+        }
+        else
+        {
+            used += sprintf(line + used, " ; .STRINGZ character x%02X\n", ch);
+        }
+        sink->used += used;
+    }
+}
+
+void emitEnd(OutputWriter *writer)
+{
+    if (writer->deferred)
+    {
+        appendOutputEntry(writer, ENTRY_END);
+        return;
+    }
+
+    // Since there's no binary equivalent for .END, the listing just notes the end of the program
+    if (writer->format == FORMAT_LISTING)
+    {
+        writeOutputText(&writer->sink, "; END OF PROGRAM\n");
+    }
+}
+
+// Emits a held-back entry for real, the writer must not be deferred
+void replayOutputEntry(OutputWriter *writer, const OutputEntry *entry)
+{
+    switch (entry->kind)
+    {
+        case ENTRY_ORIGIN:
+            emitOrigin(writer, entry->word);
+            break;
+        case ENTRY_INSTRUCTION:
+            emitInstruction(writer, entry->word, entry->comment);
+            break;
+        case ENTRY_FILL:
+            emitFill(writer, entry->word);
+            break;
+        case ENTRY_RESERVED:
+            emitReserved(writer, entry->blockSize, entry->word);
+            break;
+        case ENTRY_STRING:
+            emitString(writer, entry->characters, entry->blockSize);
+            break;
+        case ENTRY_END:
+            emitEnd(writer);
+            break;
+    }
+}
+
+/*
+    Writes out the held-back entries numbered below limit (INT_MAX for all
+    of them). Nothing happens unless at least half of what is held can go,
+    so moving the rest down stays amortized constant per entry.
+*/
+void flushOutputWriter(OutputWriter *writer, int limit)
+{
+    int count = limit - writer->entryBase;
+    if (count > writer->entryCount)
+    {
+        count = writer->entryCount;
+    }
+    if (count <= 0 || count * 2 < writer->entryCount)
+    {
+        return;
+    }
+
+    bool deferred = writer->deferred;
+    writer->deferred = false;
+
+    int i;
+    for (i = 0; i < count; i++)
+    {
+        const OutputEntry *entry = &writer->entries[i];
+        replayOutputEntry(writer, entry);
+        if (entry->kind == ENTRY_STRING)
+        {
+            free(entry->characters);
+        }
+    }
+
+    writer->deferred = deferred;
+    memmove(writer->entries, writer->entries + count, (writer->entryCount - count) * sizeof(OutputEntry));
+    writer->entryCount -= count;
+    writer->entryBase += count;
+}
+
+#endif
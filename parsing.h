@@ -7,21 +7,91 @@
 #include <stdbool.h>
 #include <ctype.h>
 
-bool parseORIG(char *source, int *minIndex, unsigned int *address)
+/*
+    Operands are read straight off the line into an Operands struct: each
+    one is scanned once, checked and converted where it stands, with no
+    copy and no joined string to split again.
+*/
+TokenView scanOperand(Lexer *lexer)
+{
+    while (isspace(peek(lexer, 0))) 
+    {
+        consume(lexer);
+    }
+
+    TokenView token;
+    token.start = lexer->source + lexer->index;
+    while (!isspace(peek(lexer, 0)) && peek(lexer, 0) != ',' && peek(lexer, 0) != ';' && peek(lexer, 0) != '\0') 
+    {
+        consume(lexer);
+    }
+    token.length = (size_t)(lexer->source + lexer->index - token.start);
+    return token;
+}
+
+// Same rule as validateRegisterToken: exactly R0 to R7
+bool registerFromView(TokenView token, int *reg)
+{
+    if (token.length == 2 && token.start[0] == 'R' && token.start[1] >= '0' && token.start[1] <= '7')
+    {
+        *reg = token.start[1] - '0';
+        return true;
+    }
+    return false;
+}
+
+// Same rule as isImm5: a '#' and a value that fits in a word; the field width is checked by the caller
+bool immediateFromView(TokenView token, int *value)
 {
-    char *endPtr;
+    if (token.length == 0 || token.start[0] != '#')
+    {
+        return false;
+    }
 
-    while (isspace(source[*minIndex])) (*minIndex)++;
-    if (source[*minIndex] != 'x' && source[*minIndex] != 'X') return false; // Ensure it starts with 'x'
-    (*minIndex)++; // Skip 'x'
+    token.start++;
+    token.length--;
+    int immValue = viewToInt(token, 10);
+    if (immValue < -32768 || immValue > 32767)
+    {
+        LOG_ERROR("Immediate value #%.*s is out of range.\n", (int)token.length, token.start);
+        return false;
+    }
+    *value = immValue;
+    return true;
+}
 
-    // Convert the hexadecimal string to an unsigned int
-    *address = strtoul(source + *minIndex, &endPtr, 16);
+// SR2, or #imm5 with operands->immediate set
+bool registerOrImmediateFromView(TokenView token, Operands *operands)
+{
+    if (registerFromView(token, &operands->sr2))
+    {
+        return true;
+    }
+    operands->immediate = immediateFromView(token, &operands->imm);
+    return operands->immediate;
+}
 
-    *minIndex += (endPtr - (source + *minIndex));
+bool parseORIG(Lexer *lexer, unsigned int *address)
+{
+    while (isspace(peek(lexer, 0))) lexer->index++;
+    if (peek(lexer, 0) != 'x' && peek(lexer, 0) != 'X') return false; // Ensure it starts with 'x'
+    lexer->index++; // Skip 'x'
 
-    // If endPtr is not at a whitespace or end of string, parsing failed
-    if (*endPtr != '\0' && !isspace(*endPtr)) 
+    // Convert the hexadecimal digits, the line is not null-terminated so strtoul could run past it
+    *address = 0;
+    while (isxdigit(peek(lexer, 0)))
+    {
+        char digit = lexer->source[lexer->index++];
+        *address = *address * 16 + (isdigit(digit) ? digit - '0' : tolower(digit) - 'a' + 10);
+        if (*address > 0xFFFF)
+        {
+            LOG_ERROR(".ORIG address is out of range.\n");
+            return false;
+        }
+    }
+
+    // If the digits are not followed by whitespace or the end of the line, parsing failed
+    if (peek(lexer, 0) != '\0' && !isspace(peek(lexer, 0))) 
     {
         return false; // Failed
     }
@@ -39,69 +109,35 @@ bool parseORIG(char *source, int *minIndex, unsigned int *address)
     else
         Invalid
 */
-bool parseADD(char *source, int *minIndex, char *operandsOut) 
+bool parseADD(Lexer *lexer, Operands *operands) 
 {
-    int tokenCount;
-    char operands[256] = "";
-    
-    for (tokenCount = 0; tokenCount < 3; tokenCount++) 
+    if (!registerFromView(scanOperand(lexer), &operands->dr)) 
     {
-        // Skip any leading whitespace
-        while (isspace(peek(0, source, minIndex))) 
-        {
-            consume(source, minIndex);
-        }
-
-        char tokenBuffer[256];
-        int tokenIndex = 0; // Initialize tokenIndex to 0
-        while (!isspace(peek(0, source, minIndex)) && peek(0, source, minIndex) != ',' && peek(0, source, minIndex) != '\0') 
-        {
-            tokenBuffer[tokenIndex] = consume(source, minIndex);
-            tokenIndex++;
-        }
-        tokenBuffer[tokenIndex] = '\0';
+        return false;
+    }
 
-        // Validate operands: the first two must be registers, and the third can be a register or an immediate value
-        if (tokenCount < 2) 
-        {
-            // For the first two operands, check if they are valid registers
-            if (!isRegister(tokenBuffer)) 
-            {
-                return false;
-            }
-        } 
-        else 
-        {
-            // For the third operand, it can be either a register or an immediate value
-            if (!(isRegister(tokenBuffer) || isImm5(tokenBuffer))) 
-            {
-                return false;
-            }
-        }
+    // After the first two operands, expect a comma before the next operand
+    while (isspace(peek(lexer, 0))) consume(lexer);
+    if (peek(lexer, 0) != ',') 
+    {
+        return false;
+    }
+    consume(lexer);
 
-        if (tokenCount > 0) 
-        {
-            strcat(operands, ","); // Separate operands with commas
-        }
-        strcat(operands, tokenBuffer);
+    if (!registerFromView(scanOperand(lexer), &operands->sr1)) 
+    {
+        return false;
+    }
 
-        // After the first two operands, expect a comma before the next operand
-        if (tokenCount < 2) 
-        {
-            while (isspace(peek(0, source, minIndex))) consume(source, minIndex); // Consume spaces before checking for a comma
-            if (peek(0, source, minIndex) != ',') 
-            {
-                return false;
-            } 
-            else 
-            {
-                consume(source, minIndex); // Consume the comma
-            }
-        }
+    while (isspace(peek(lexer, 0))) consume(lexer);
+    if (peek(lexer, 0) != ',') 
+    {
+        return false;
     }
+    consume(lexer);
 
-    strcpy(operandsOut, operands);
-    return true;
+    // The third operand can be either a register or an immediate value
+    return registerOrImmediateFromView(scanOperand(lexer), operands);
 }
 
 /* 
@@ -114,59 +150,31 @@ bool parseADD(char *source, int *minIndex, char *operandsOut)
     else
         Invalid
 */
-bool parseAND(char *source, int *minIndex, char *operandsOut) 
+bool parseAND(Lexer *lexer, Operands *operands) 
 {
-    int tokenCount;
-    char operands[256] = "";
-
-    for (tokenCount = 0; tokenCount < 3; tokenCount++) 
+    if (!registerFromView(scanOperand(lexer), &operands->dr)) 
     {
-        while (isspace(peek(0, source, minIndex))) 
-        {
-            consume(source, minIndex);
-        }
-
-        char tokenBuffer[256];
-        int tokenIndex = 0; // Start at index 0
-        while (!isspace(peek(0, source, minIndex)) && peek(0, source, minIndex) != ',' && peek(0, source, minIndex) != '\0') 
-        {
-            tokenBuffer[tokenIndex] = consume(source, minIndex); // Assign before increment
-            tokenIndex++;
-        }
-        tokenBuffer[tokenIndex] = '\0';
+        return false;
+    }
 
-        // For the first two tokens, check if they are valid registers
-        if (tokenCount < 2) 
-        {
-            if (!isRegister(tokenBuffer)) 
-            {
-                return false;
-            }
-        } 
-        else 
-        {
-            // For the third token, it can be a register or an immediate value
-            if (!(isRegister(tokenBuffer) || isImm5(tokenBuffer))) 
-            {
-                return false;
-            }
-        }
+    // Consume a comma after the first two tokens if there is one
+    if (peek(lexer, 0) == ',') 
+    {
+        consume(lexer);
+    }
 
-        if (tokenCount > 0) 
-        {
-            strcat(operands, ","); // Separate operands with commas
-        }
-        strcat(operands, tokenBuffer);
+    if (!registerFromView(scanOperand(lexer), &operands->sr1)) 
+    {
+        return false;
+    }
 
-        // Consume a comma after the first two tokens if there are more tokens to read
-        if (tokenCount < 2 && peek(0, source, minIndex) == ',') 
-        {
-            consume(source, minIndex);
-        }
+    if (peek(lexer, 0) == ',') 
+    {
+        consume(lexer);
     }
 
-    strcpy(operandsOut, operands);
-    return true;
+    // The third token can be a register or an immediate value
+    return registerOrImmediateFromView(scanOperand(lexer), operands);
 }
 
 /* 
@@ -181,34 +189,22 @@ bool parseAND(char *source, int *minIndex, char *operandsOut)
     else
         Invalid
 */
-bool parseBR(const char *instruction, char labels[][MAX_LABEL_LEN], int labelCount, char *labelOut) 
+bool parseBR(Lexer *lexer, char *targetLabel) 
 {
-    // Check if instruction starts with "BR"
-    if (strncmp(instruction, "BR", 2) != 0) 
+    // The condition codes were part of the mnemonic, only the label is left
+    while (isspace(peek(lexer, 0))) 
     {
-        return false;
+        consume(lexer);
     }
 
-    int i = 2; // Start index after "BR"
-    // Skip condition codes
-    while (instruction[i] == 'n' || instruction[i] == 'z' || instruction[i] == 'p') 
-    {
-        i++;
-    }
-
-    // Move past any whitespace after condition codes
-    while (isspace(instruction[i])) i++;
-
-    // Copy label to labelOut, ensuring null termination
-    int j = 0;
-    while (instruction[i] != '\0' && instruction[i] != ';' && !isspace(instruction[i])) 
+    int labelIndex = 0;
+    while (!isspace(peek(lexer, 0)) && peek(lexer, 0) != '\0') 
     {
-        labelOut[j++] = instruction[i++];
+        targetLabel[labelIndex++] = consume(lexer);
     }
-    labelOut[j] = '\0'; // Ensure null termination
+    targetLabel[labelIndex] = '\0';
 
-    // Validate extracted label is not empty and exists
-    return strlen(labelOut) > 0 && isValidLabel(labelOut, labels, labelCount);
+    return labelIndex > 0;
 }
 
 /* 
@@ -220,48 +216,38 @@ bool parseBR(const char *instruction, char labels[][MAX_LABEL_LEN], int labelCou
     else
         Invalid
 */
-bool parseLD(char *source, int *minIndex, char labels[][MAX_LABEL_LEN], int labelCount, char *dr, char *targetLabel) 
+bool parseLD(Lexer *lexer, int *dr, char *targetLabel) 
 {
     // Skip whitespace before DR
-    while (isspace(peek(0, source, minIndex))) 
+    while (isspace(peek(lexer, 0))) 
     {
-        consume(source, minIndex);
+        consume(lexer);
     }
 
     // Parse DR
-    char tokenBuffer[256];
-    int tokenIndex = 0;
-    while (!isspace(peek(0, source, minIndex)) && peek(0, source, minIndex) != ',' && peek(0, source, minIndex) != '\0') 
-    {
-        tokenBuffer[tokenIndex++] = consume(source, minIndex);
-    }
-    tokenBuffer[tokenIndex] = '\0';
-
-    if (!isRegister(tokenBuffer)) 
+    if (!registerFromView(scanOperand(lexer), dr)) 
     {
         return false;
     }
-    strcpy(dr, tokenBuffer); // Copy the DR register to output parameter
 
     // Skip whitespace (and comma if present) before the label
-    while (isspace(peek(0, source, minIndex)) || peek(0, source, minIndex) == ',') 
+    while (isspace(peek(lexer, 0)) || peek(lexer, 0) == ',') 
     {
-        consume(source, minIndex);
+        consume(lexer);
     }
 
-    // Reset for label parsing
-    tokenIndex = 0;
-    // Parse LABEL
-    while (!isspace(peek(0, source, minIndex)) && peek(0, source, minIndex) != '\0') 
+    // Parse LABEL straight into the output parameter, resolved by the caller
+    int labelIndex = 0;
+    while (!isspace(peek(lexer, 0)) && peek(lexer, 0) != '\0') 
     {
-        tokenBuffer[tokenIndex++] = consume(source, minIndex);
+        targetLabel[labelIndex++] = consume(lexer);
     }
-    tokenBuffer[tokenIndex] = '\0';
+    targetLabel[labelIndex] = '\0';
 
-    if (!isValidLabel(tokenBuffer, labels, labelCount)) {
+    if (labelIndex == 0) 
+    {
         return false;
     }
-    strcpy(targetLabel, tokenBuffer); // Copy the target label to output parameter
 
     return true;
 }
@@ -275,55 +261,44 @@ bool parseLD(char *source, int *minIndex, char labels[][MAX_LABEL_LEN], int labe
     else
         Invalid
 */
-bool parseLDI(char *source, int *minIndex, char labels[][MAX_LABEL_LEN], int labelCount, char *dr, char *targetLabel) 
+bool parseLDI(Lexer *lexer, int *dr, char *targetLabel) 
 {
     // Skip any whitespace after the "LDI" instruction
-    while (isspace(peek(0, source, minIndex))) 
+    while (isspace(peek(lexer, 0))) 
     {
-        consume(source, minIndex);
+        consume(lexer);
     }
 
     // Parse and validate the destination register (DR)
-    char registerBuffer[256];
-    int registerIndex = 0;
-    while (!isspace(peek(0, source, minIndex)) && peek(0, source, minIndex) != ',' && peek(0, source, minIndex) != '\0') 
+    TokenView registerToken = scanOperand(lexer);
+    if (!registerFromView(registerToken, dr)) 
     {
-        registerBuffer[registerIndex++] = consume(source, minIndex);
-    }
-    registerBuffer[registerIndex] = '\0'; // Null-terminate the register part
-
-    if (!isRegister(registerBuffer)) 
-    {
-        printf("Register not valid: %s\n", registerBuffer);
+        LOG_ERROR("Register not valid: %.*s\n", (int)registerToken.length, registerToken.start);
         return false;
     }
-    strcpy(dr, registerBuffer); // Copy the DR register to the output parameter
 
     // Skip the comma and any whitespace before the label
-    if (peek(0, source, minIndex) == ',') 
+    if (peek(lexer, 0) == ',') 
     {
-        consume(source, minIndex); // Consume the comma
+        consume(lexer); // Consume the comma
     }
-    while (isspace(peek(0, source, minIndex))) 
+    while (isspace(peek(lexer, 0))) 
     {
-        consume(source, minIndex);
+        consume(lexer);
     }
 
     // Parse the label
-    char labelBuffer[256];
     int labelIndex = 0;
-    while (peek(0, source, minIndex) != '\0' && peek(0, source, minIndex) != ';' && !isspace(peek(0, source, minIndex))) 
+    while (peek(lexer, 0) != '\0' && peek(lexer, 0) != ';' && !isspace(peek(lexer, 0))) 
     {
-        labelBuffer[labelIndex++] = consume(source, minIndex);
+        targetLabel[labelIndex++] = consume(lexer);
     }
-    labelBuffer[labelIndex] = '\0'; // Null-terminate the label
+    targetLabel[labelIndex] = '\0'; // Resolved by the caller
 
-    if (!isValidLabel(labelBuffer, labels, labelCount)) 
+    if (labelIndex == 0) 
     {
-        printf("Label not valid or not found for LDI: %s\n", labelBuffer);
         return false;
     }
-    strcpy(targetLabel, labelBuffer); // Copy the target label to the output parameter
 
     return true;
 }
@@ -337,64 +312,23 @@ bool parseLDI(char *source, int *minIndex, char labels[][MAX_LABEL_LEN], int lab
     else
         Invalid
 */
-bool parseLDR(char *source, int *minIndex, char *operandsBuffer) 
+bool parseLDR(Lexer *lexer, Operands *operands) 
 {
-    int tokenCount;
-    operandsBuffer[0] = '\0'; // Ensure the buffer starts empty.
-
-    for (tokenCount = 0; tokenCount < 3; tokenCount++) 
+    // The first two tokens must be registers, each followed directly by a comma
+    if (!registerFromView(scanOperand(lexer), &operands->dr) || peek(lexer, 0) != ',') 
     {
-        // Skip whitespace
-        while (isspace(peek(0, source, minIndex))) 
-        {
-            consume(source, minIndex);
-        }
-
-        char tokenBuffer[256];
-        int tokenIndex = 0; // Initialize tokenIndex to 0
-        while (!isspace(peek(0, source, minIndex)) && peek(0, source, minIndex) != ',' && peek(0, source, minIndex) != '\0') 
-        {
-            tokenBuffer[tokenIndex++] = consume(source, minIndex); // Use tokenIndex++ to increment after use
-        }
-        tokenBuffer[tokenIndex] = '\0'; // Null-terminate the token
-
-        // Append the token to the operands buffer, separating operands with a comma
-        if (tokenCount > 0) 
-        {
-            strncat(operandsBuffer, ",", 255 - strlen(operandsBuffer));
-        }
-        strncat(operandsBuffer, tokenBuffer, 255 - strlen(operandsBuffer));
-
-        if (tokenCount < 2) 
-        {
-            if (!isRegister(tokenBuffer)) 
-            {
-                return false; // The first two tokens must be registers
-            }
-        } 
-        else 
-        {
-            if (!isOffset6(tokenBuffer)) 
-            {
-                return false; // The last token must be an offset6
-            }
-        }
+        return false;
+    }
+    consume(lexer);
 
-        // Consume the comma after the first two operands but not after the third
-        if (tokenCount < 2) 
-        {
-            if (peek(0, source, minIndex) != ',') 
-            {
-                return false; // Expecting a comma here
-            } 
-            else 
-            {
-                consume(source, minIndex); // Consume the comma
-            }
-        }
+    if (!registerFromView(scanOperand(lexer), &operands->sr1) || peek(lexer, 0) != ',') 
+    {
+        return false;
     }
+    consume(lexer);
 
-    return true; // If all tokens are parsed successfully, return true
+    // The last token must be an offset6
+    return immediateFromView(scanOperand(lexer), &operands->imm) && fitsInBits(operands->imm, IMMEDIATE_SIZE_LDR_STR);
 }
 
 /* 
@@ -406,53 +340,43 @@ bool parseLDR(char *source, int *minIndex, char *operandsBuffer)
     else
         Invalid
 */
-bool parseLEA(char *source, int *minIndex, char labels[][MAX_LABEL_LEN], int labelCount, char *dr, char *targetLabel) 
+bool parseLEA(Lexer *lexer, int *dr, char *targetLabel) 
 {
-    while (isspace(peek(0, source, minIndex))) 
+    while (isspace(peek(lexer, 0))) 
     {
-        consume(source, minIndex);
+        consume(lexer);
     }
 
     // Parse and validate the destination register (DR)
-    char registerBuffer[256];
-    int registerIndex = 0;
-    while (!isspace(peek(0, source, minIndex)) && peek(0, source, minIndex) != ',' && peek(0, source, minIndex) != '\0') 
+    TokenView registerToken = scanOperand(lexer);
+    if (!registerFromView(registerToken, dr)) 
     {
-        registerBuffer[registerIndex++] = consume(source, minIndex);
-    }
-    registerBuffer[registerIndex] = '\0'; // Null-terminate the register part
-
-    if (!isRegister(registerBuffer)) 
-    {
-        printf("Invalid register for LEA: %s\n", registerBuffer);
+        LOG_ERROR("Invalid register for LEA: %.*s\n", (int)registerToken.length, registerToken.start);
         return false;
     }
-    strcpy(dr, registerBuffer); // Copy the DR register to output parameter
 
     // Skip the comma and whitespace before the label
-    if (peek(0, source, minIndex) == ',') 
+    if (peek(lexer, 0) == ',') 
     {
-        consume(source, minIndex); // Consume the comma
+        consume(lexer); // Consume the comma
     }
-    while (isspace(peek(0, source, minIndex))) 
+    while (isspace(peek(lexer, 0))) 
     {
-        consume(source, minIndex);
+        consume(lexer);
     }
 
     // Parse and validate the label
-    char labelBuffer[256];
     int labelIndex = 0;
-    while (peek(0, source, minIndex) != '\0' && peek(0, source, minIndex) != ';' && !isspace(peek(0, source, minIndex))) 
+    while (peek(lexer, 0) != '\0' && peek(lexer, 0) != ';' && !isspace(peek(lexer, 0))) 
     {
-        labelBuffer[labelIndex++] = consume(source, minIndex); // Increment and assign
+        targetLabel[labelIndex++] = consume(lexer);
     }
-    labelBuffer[labelIndex] = '\0'; // Null-terminate the label part
+    targetLabel[labelIndex] = '\0'; // Resolved by the caller
 
-    if (!isValidLabel(labelBuffer, labels, labelCount)) {
-        printf("Invalid label for LEA: %s\n", labelBuffer);
+    if (labelIndex == 0) 
+    {
         return false;
     }
-    strcpy(targetLabel, labelBuffer); // Copy the target label to output parameter
 
     return true;
 }
@@ -466,55 +390,20 @@ bool parseLEA(char *source, int *minIndex, char labels[][MAX_LABEL_LEN], int lab
     else
         Invalid
 */
-bool parseNOT(char *source, int *minIndex, char *operandsOut) 
+bool parseNOT(Lexer *lexer, Operands *operands) 
 {
-    char drBuffer[256], srBuffer[256];
-    int drIndex = 0, srIndex = 0;
+    TokenView dr = scanOperand(lexer);
     bool commaEncountered = false;
 
-    // Initialize the operands output string.
-    operandsOut[0] = '\0';
-
-    // Skip whitespace before the first register (DR)
-    while (isspace(peek(0, source, minIndex))) 
-    {
-        consume(source, minIndex);
-    }
-
-    // Collect characters for DR until a comma or whitespace is encountered
-    while (!isspace(peek(0, source, minIndex)) && peek(0, source, minIndex) != ',' && peek(0, source, minIndex) != '\0') 
-    {
-        drBuffer[drIndex++] = consume(source, minIndex);
-    }
-    drBuffer[drIndex] = '\0'; // Null-terminate the DR operand
-
     // Skip over comma and whitespace to reach the second register (SR)
-    while (peek(0, source, minIndex) == ',' || isspace(peek(0, source, minIndex))) 
+    while (peek(lexer, 0) == ',' || isspace(peek(lexer, 0))) 
     {
-        consume(source, minIndex);
+        consume(lexer);
         commaEncountered = true; // Ensure a comma has been encountered to expect SR
     }
 
-    // Only proceed to parse SR if a comma was encountered after DR
-    if (commaEncountered) 
-    {
-        // Collect characters for SR
-        while (!isspace(peek(0, source, minIndex)) && peek(0, source, minIndex) != '\0') 
-        {
-            srBuffer[srIndex++] = consume(source, minIndex);
-        }
-        srBuffer[srIndex] = '\0'; // Null-terminate the SR operand
-
-        // Validate both operands are valid registers
-        if (isRegister(drBuffer) && isRegister(srBuffer)) 
-        {
-            // Format operandsOut as "DR,SR"
-            sprintf(operandsOut, "%s,%s", drBuffer, srBuffer);
-            return true; // Successfully parsed both registers
-        }
-    }
-
-    return false; // Failed to parse valid registers for NOT instruction
+    // Only proceed to parse SR if a comma was encountered after DR, and both must be valid registers
+    return commaEncountered && registerFromView(dr, &operands->dr) && registerFromView(scanOperand(lexer), &operands->sr1);
 }
 
 /* 
@@ -526,55 +415,44 @@ bool parseNOT(char *source, int *minIndex, char *operandsOut)
     else
         Invalid
 */
-bool parseST(char *source, int *minIndex, char labels[][MAX_LABEL_LEN], int labelCount, char *sr, char *targetLabel) 
+bool parseST(Lexer *lexer, int *sr, char *targetLabel) 
 {
     // Skip whitespace before SR
-    while (isspace(peek(0, source, minIndex))) 
+    while (isspace(peek(lexer, 0))) 
     {
-        consume(source, minIndex);
+        consume(lexer);
     }
 
     // SR part
-    char registerBuffer[256];
-    int registerIndex = 0; 
-    while (!isspace(peek(0, source, minIndex)) && peek(0, source, minIndex) != ',' && peek(0, source, minIndex) != '\0') 
-    {
-        registerBuffer[registerIndex++] = consume(source, minIndex);
-    }
-    registerBuffer[registerIndex] = '\0'; // Null-terminate the register part
-
-    if (!isRegister(registerBuffer)) 
+    TokenView registerToken = scanOperand(lexer);
+    if (!registerFromView(registerToken, sr)) 
     {
-        printf("Register not valid: %s\n", registerBuffer);
+        LOG_ERROR("Register not valid: %.*s\n", (int)registerToken.length, registerToken.start);
         return false;
     }
-    strcpy(sr, registerBuffer); // Copy the SR register to output parameter
 
     // Skip the comma and whitespace before the label
-    if (peek(0, source, minIndex) == ',') 
+    if (peek(lexer, 0) == ',') 
     {
-        consume(source, minIndex); // Consume the comma
+        consume(lexer); // Consume the comma
     }
-    while (isspace(peek(0, source, minIndex))) 
+    while (isspace(peek(lexer, 0))) 
     {
-        consume(source, minIndex);
+        consume(lexer);
     }
 
     // Label part
-    char labelBuffer[256];
-    int labelIndex = 0; 
-    while (peek(0, source, minIndex) != '\0' && peek(0, source, minIndex) != ';' && !isspace(peek(0, source, minIndex))) 
+    int labelIndex = 0;
+    while (peek(lexer, 0) != '\0' && peek(lexer, 0) != ';' && !isspace(peek(lexer, 0))) 
     {
-        labelBuffer[labelIndex++] = consume(source, minIndex);
+        targetLabel[labelIndex++] = consume(lexer);
     }
-    labelBuffer[labelIndex] = '\0'; // Null-terminate the label part
+    targetLabel[labelIndex] = '\0'; // Resolved by the caller
 
-    if (!isValidLabel(labelBuffer, labels, labelCount)) 
+    if (labelIndex == 0) 
     {
-        printf("Label not valid or not found for ST: %s\n", labelBuffer);
         return false;
     }
-    strcpy(targetLabel, labelBuffer); // Copy the target label to output parameter
 
     return true;
 }
@@ -588,54 +466,43 @@ bool parseST(char *source, int *minIndex, char labels[][MAX_LABEL_LEN], int labe
     else
         Invalid
 */
-bool parseSTI(char *source, int *minIndex, char labels[][MAX_LABEL_LEN], int labelCount, char *sr, char *targetLabel) 
+bool parseSTI(Lexer *lexer, int *sr, char *targetLabel) 
 {
-    while (isspace(peek(0, source, minIndex))) 
+    while (isspace(peek(lexer, 0))) 
     {
-        consume(source, minIndex);
+        consume(lexer);
     }
 
     // SR part
-    char registerBuffer[256];
-    int registerIndex = 0;
-    while (!isspace(peek(0, source, minIndex)) && peek(0, source, minIndex) != ',' && peek(0, source, minIndex) != '\0') 
-    {
-        registerBuffer[registerIndex++] = consume(source, minIndex);
-    }
-    registerBuffer[registerIndex] = '\0';
-
-    if (!isRegister(registerBuffer)) 
+    TokenView registerToken = scanOperand(lexer);
+    if (!registerFromView(registerToken, sr)) 
     {
-        printf("Invalid register for STI: %s\n", registerBuffer);
+        LOG_ERROR("Invalid register for STI: %.*s\n", (int)registerToken.length, registerToken.start);
         return false;
     }
-    strcpy(sr, registerBuffer); // Copy the SR register to output parameter
 
     // Skip over the comma (if present) and whitespace after the register
-    if (peek(0, source, minIndex) == ',') 
+    if (peek(lexer, 0) == ',') 
     {
-        consume(source, minIndex);
+        consume(lexer);
     }
-    while (isspace(peek(0, source, minIndex))) 
+    while (isspace(peek(lexer, 0))) 
     {
-        consume(source, minIndex);
+        consume(lexer);
     }
 
     // Label part
-    char labelBuffer[256];
     int labelIndex = 0;
-    while (peek(0, source, minIndex) != '\0' && peek(0, source, minIndex) != ';' && !isspace(peek(0, source, minIndex))) 
+    while (peek(lexer, 0) != '\0' && peek(lexer, 0) != ';' && !isspace(peek(lexer, 0))) 
     {
-        labelBuffer[labelIndex++] = consume(source, minIndex);
+        targetLabel[labelIndex++] = consume(lexer);
     }
-    labelBuffer[labelIndex] = '\0';
+    targetLabel[labelIndex] = '\0'; // Resolved by the caller
 
-    if (!isValidLabel(labelBuffer, labels, labelCount)) 
+    if (labelIndex == 0) 
     {
-        printf("Invalid label for STI: %s\n", labelBuffer);
         return false;
     }
-    strcpy(targetLabel, labelBuffer); // Copy the target label to output parameter
 
     return true;
 }
@@ -649,49 +516,10 @@ bool parseSTI(char *source, int *minIndex, char labels[][MAX_LABEL_LEN], int lab
     else
         Invalid
 */
-bool parseSTR(char *source, int *minIndex, char *operandsOut) 
+bool parseSTR(Lexer *lexer, Operands *operands) 
 {
-    int tokenCount;
-    operandsOut[0] = '\0';  // Initialize the operands output string.
-
-    for (tokenCount = 0; tokenCount < 3; tokenCount++) 
-    {
-        // Skip whitespace
-        while (isspace(peek(0, source, minIndex))) 
-        {
-            consume(source, minIndex);
-        }
-
-        char tokenBuffer[256];
-        int tokenIndex = 0; // Initialize tokenIndex to 0
-        while (!isspace(peek(0, source, minIndex)) && peek(0, source, minIndex) != ',' && peek(0, source, minIndex) != '\0') 
-        {
-            tokenBuffer[tokenIndex++] = consume(source, minIndex); // Corrected to tokenIndex++
-        }
-        tokenBuffer[tokenIndex] = '\0'; // Null-terminate the token
-
-        // Append the token to the operands output
-        strcat(operandsOut, tokenBuffer);
-        if (tokenCount < 2) 
-        {
-            strcat(operandsOut, ",");  // Add a comma after the first two operands
-        }
-
-        if (tokenCount < 2) 
-        {
-            // Consume the comma after the first two operands
-            if (peek(0, source, minIndex) != ',') 
-            {
-                return false;
-            } 
-            else 
-            {
-                consume(source, minIndex);
-            }
-        }
-    }
-
-    return true; // Return true if all operands are valid and processed
+    // Same operands as LDR, SR in place of DR, only the encoding differs
+    return parseLDR(lexer, operands);
 }
 
 /* 
@@ -703,17 +531,17 @@ bool parseSTR(char *source, int *minIndex, char *operandsOut)
     else
         Invalid
 */
-bool parseTRAP(char *source, int *minIndex, int *trapVector) 
+bool parseTRAP(Lexer *lexer, int *trapVector) 
 {
-    while (isspace(source[*minIndex])) (*minIndex)++;
-    if (source[*minIndex] != 'x' && source[*minIndex] != 'X') return false;
+    while (isspace(peek(lexer, 0))) lexer->index++;
+    if (peek(lexer, 0) != 'x' && peek(lexer, 0) != 'X') return false;
 
-    (*minIndex)++; // Skip 'x' or 'X'
+    lexer->index++; // Skip 'x' or 'X'
     char trapVectorStr[5]; // Enough to hold 4 hex digits and a null terminator
     int i = 0;
-    while (isxdigit(source[*minIndex]) && i < 4) 
+    while (isxdigit(peek(lexer, 0)) && i < 4) 
     {
-        trapVectorStr[i++] = source[(*minIndex)++];
+        trapVectorStr[i++] = lexer->source[lexer->index++];
     }
     trapVectorStr[i] = '\0'; // Null-terminate the string
 
@@ -724,33 +552,88 @@ bool parseTRAP(char *source, int *minIndex, int *trapVector)
     return true; // Successfully parsed trap vector
 }
 
-bool parseSEMI(char *source, int *minIndex)
+/* 
+    JMP -> Validate
+    if 
+        1 parameter
+        case:
+            BaseR
+    else
+        Invalid
+*/
+bool parseJMP(Lexer *lexer, Operands *operands) 
+{
+    return registerFromView(scanOperand(lexer), &operands->sr1);
+}
+
+/* 
+    JSR -> Validate
+    if 
+        1 parameter
+        case:
+            LABEL (PCoffset11)
+    else
+        Invalid
+*/
+bool parseJSR(Lexer *lexer, char *targetLabel) 
+{
+    while (isspace(peek(lexer, 0))) 
+    {
+        consume(lexer);
+    }
+
+    int labelIndex = 0;
+    while (!isspace(peek(lexer, 0)) && peek(lexer, 0) != ';' && peek(lexer, 0) != '\0') 
+    {
+        targetLabel[labelIndex++] = consume(lexer);
+    }
+    targetLabel[labelIndex] = '\0';
+
+    return labelIndex > 0;
+}
+
+/* 
+    JSRR -> Validate
+    if 
+        1 parameter
+        case:
+            BaseR
+    else
+        Invalid
+*/
+bool parseJSRR(Lexer *lexer, Operands *operands) 
 {
-    if (peek(0, source, minIndex) != ';')
+    // Same operand as JMP, only the encoding differs
+    return parseJMP(lexer, operands);
+}
+
+bool parseSEMI(Lexer *lexer)
+{
+    if (peek(lexer, 0) != ';')
     {
         return true;
     }
 
-    while (peek(0, source, minIndex) != '\n' && peek(0, source, minIndex) != '\0')
+    while (peek(lexer, 0) != '\n' && peek(lexer, 0) != '\0')
     {
-        consume(source, minIndex);
+        consume(lexer);
     }
 
     return true;
 }
 
-bool parseFILL(char *source, int *minIndex, int *immValue) 
+bool parseFILL(Lexer *lexer, int *immValue) 
 {
     // Skip whitespace
-    while (isspace(source[*minIndex])) (*minIndex)++;
+    while (isspace(peek(lexer, 0))) lexer->index++;
 
     // Extract the operand
-    char operandBuffer[256];
+    char *operandBuffer = allocTokenBuffer(lexer);
     int i = 0;
-    while (source[*minIndex] != '\0' && source[*minIndex] != '\n' && !isspace(source[*minIndex])) 
+    while (peek(lexer, 0) != '\0' && peek(lexer, 0) != '\n' && !isspace(peek(lexer, 0))) 
     {
-        operandBuffer[i++] = source[*minIndex];
-        (*minIndex)++;
+        operandBuffer[i++] = peek(lexer, 0);
+        lexer->index++;
     }
     operandBuffer[i] = '\0'; // Null-terminate the string
 
@@ -773,48 +656,85 @@ bool parseFILL(char *source, int *minIndex, int *immValue)
     return true;
 }
 
-bool parseEND(char *source, int *minIndex) 
+bool parseEND(Lexer *lexer) 
 {
     // Move past any whitespace before checking for .END
-    while (isspace(source[*minIndex])) 
+    while (isspace(peek(lexer, 0))) 
     {
-        (*minIndex)++;
+        lexer->index++;
     }
 
     // Check if the rest of the line is just comments or whitespace
-    while (source[*minIndex] != '\0' && source[*minIndex] != '\n') 
+    while (peek(lexer, 0) != '\0' && peek(lexer, 0) != '\n') 
     {
-        if (source[*minIndex] == ';') 
+        if (peek(lexer, 0) == ';') 
         {
             // .END is valid, there's a comment following it
             return true;
         } 
-        else if (!isspace(source[*minIndex])) 
+        else if (!isspace(peek(lexer, 0))) 
         {
             // Found a non-space character before a comment or end of line, .END is not valid
             return false;
         }
-        (*minIndex)++;
+        lexer->index++;
     }
 
     // Reached the end of the line without finding non-whitespace characters before any comment
     return true;
 }
 
-bool parseBLKW(char *source, int *minIndex, int *blockSize) 
+/* 
+    .STRINGZ -> Validate
+    if 
+        1 parameter
+        case:
+            "string" with escapes
+    else
+        Invalid
+*/
+bool parseSTRINGZ(Lexer *lexer, char *charactersOut, int *length) 
+{
+    size_t position = lexer->index;
+    *length = decodeStringLiteral(lexer->source, lexer->length, &position, charactersOut);
+    if (*length < 0) 
+    {
+        return false;
+    }
+
+    lexer->index = (int)position;
+    return true;
+}
+
+/* 
+    .BLKW -> Validate
+    if 
+        1 or 2 parameters, the second optionally after a ','
+        cases:
+            n
+            n, #fill | n, xFILL
+    else
+        Invalid
+*/
+bool parseBLKW(Lexer *lexer, int *blockSize, int *fillValue) 
 {
-    while (isspace(source[*minIndex])) 
+    while (isspace(peek(lexer, 0))) 
     {
-        (*minIndex)++;
+        lexer->index++;
     }
 
-    char blockSizeStr[10];
     int i = 0;
-    while (isdigit(source[*minIndex]) && i < (sizeof(blockSizeStr) - 1)) 
+    *blockSize = 0;
+    while (isdigit(peek(lexer, 0))) 
     {
-        blockSizeStr[i++] = source[(*minIndex)++];
+        char digit = lexer->source[lexer->index++];
+        if (*blockSize <= LC3_MEMORY_WORDS) 
+        {
+            // Past the size of memory it stops growing, so the int never overflows; the caller rejects it
+            *blockSize = *blockSize * 10 + (digit - '0');
+        }
+        i++;
     }
-    blockSizeStr[i] = '\0'; // Null-terminate the string
 
     if (i == 0) 
     {
@@ -822,15 +742,54 @@ bool parseBLKW(char *source, int *minIndex, int *blockSize)
         return false;
     }
 
-    *blockSize = atoi(blockSizeStr); // Convert the block size string to an integer
+    // Optional fill value, zero when absent
+    *fillValue = 0;
+    while (isspace(peek(lexer, 0)) || peek(lexer, 0) == ',') 
+    {
+        lexer->index++;
+    }
+    if (peek(lexer, 0) == '\0' || peek(lexer, 0) == ';') 
+    {
+        return true;
+    }
+
+    int base = 10;
+    if (peek(lexer, 0) == '#') 
+    {
+        lexer->index++;
+    }
+    else if (peek(lexer, 0) == 'x' || peek(lexer, 0) == 'X') 
+    {
+        lexer->index++;
+        base = 16;
+    }
+
+    bool negative = peek(lexer, 0) == '-';
+    if (negative) 
+    {
+        lexer->index++;
+    }
+
+    int digits = 0;
+    int value = 0;
+    while (base == 16 ? isxdigit(peek(lexer, 0)) : isdigit(peek(lexer, 0))) 
+    {
+        char digit = lexer->source[lexer->index++];
+        value = value * base + (isdigit(digit) ? digit - '0' : tolower(digit) - 'a' + 10);
+        if (value > 0xFFFF) 
+        {
+            return false; // Does not fit in a word
+        }
+        digits++;
+    }
 
-    if (*blockSize < 0) 
+    if (digits == 0 || (negative && value > 0x8000)) 
     {
-        // Block size is invalid if it's negative
         return false;
     }
 
-    return true; // Successfully parsed block size
+    *fillValue = negative ? -value : value;
+    return true; // Successfully parsed block size and fill value
 }
 
 #endif
\ No newline at end of file
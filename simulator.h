@@ -0,0 +1,432 @@
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <limits.h>
+
+int16_t signExtend(uint16_t value, int bits)
+{
+    uint16_t sign = (uint16_t)(1u << (bits - 1));
+    value &= (uint16_t)((1u << bits) - 1);
+    return (int16_t)((value ^ sign) - sign);
+}
+
+// The inverse of encodeInstruction, see the field layout there
+DecodedInstruction decodeWord(uint16_t word)
+{
+    DecodedInstruction decoded;
+    decoded.opcode = (uint8_t)(word >> 12);
+    decoded.dr = (word >> 9) & 0x7;
+    decoded.sr1 = (word >> 6) & 0x7;
+    decoded.sr2 = word & 0x7;
+    decoded.immediate = (word >> 5) & 0x1;
+    decoded.offset = 0;
+
+    switch (decoded.opcode)
+    {
+        case OPCODE_ADD:
+        case OPCODE_AND:
+            decoded.offset = signExtend(word, 5);
+            break;
+        case OPCODE_BR:
+        case OPCODE_LD:
+        case OPCODE_LDI:
+        case OPCODE_LEA:
+        case OPCODE_ST:
+        case OPCODE_STI:
+            decoded.offset = signExtend(word, 9);
+            break;
+        case OPCODE_LDR:
+        case OPCODE_STR:
+            decoded.offset = signExtend(word, 6);
+            break;
+        case OPCODE_JSR:
+            decoded.immediate = (word >> 11) & 0x1;
+            decoded.offset = signExtend(word, 11);
+            break;
+        case OPCODE_TRAP:
+            decoded.offset = word & 0xFF;
+            break;
+    }
+    return decoded;
+}
+
+/*
+    Memory starts out as the assembled image and every word of it is
+    decoded up front. Data words decode to something meaningless, which
+    costs nothing unless the program jumps into them.
+*/
+void loadMachine(Machine *machine, const MemoryImage *image, FILE *input, FILE *output)
+{
+    memcpy(machine->memory, image->words, sizeof(machine->memory));
+    int address;
+    for (address = 0; address < LC3_MEMORY_WORDS; address++)
+    {
+        machine->decoded[address] = decodeWord(machine->memory[address]);
+    }
+
+    memset(machine->registers, 0, sizeof(machine->registers));
+    machine->pc = image->origin;
+    machine->conditions = CONDITION_Z;
+    machine->executed = 0;
+    machine->input = input;
+    machine->output = output;
+    machine->jit = NULL;
+}
+
+// A store may overwrite code, so the decoded copy is refreshed with it
+void storeMachineWord(Machine *machine, uint16_t address, uint16_t value)
+{
+    machine->memory[address] = value;
+    machine->decoded[address] = decodeWord(value);
+}
+
+void setConditions(Machine *machine, uint16_t value)
+{
+    if (value == 0)
+    {
+        machine->conditions = CONDITION_Z;
+    }
+    else if (value & 0x8000)
+    {
+        machine->conditions = CONDITION_N;
+    }
+    else
+    {
+        machine->conditions = CONDITION_P;
+    }
+}
+
+/*
+    The service routines are built in rather than loaded into memory at
+    x0400 and up, so a trap costs one call. R7 still gets the return
+    address like on the real machine. GETC and IN read xFFFF at end of input.
+*/
+RunResult executeTrap(Machine *machine, int trapVector)
+{
+    uint16_t *registers = machine->registers;
+    registers[7] = machine->pc;
+
+    switch (trapVector)
+    {
+        case 0x20: // GETC
+            fflush(machine->output);
+            registers[0] = (uint16_t)fgetc(machine->input);
+            return RUN_RUNNING;
+        case 0x21: // OUT
+            fputc(registers[0] & 0xFF, machine->output);
+            return RUN_RUNNING;
+        case 0x22: // PUTS, one character per word up to a zero word
+        {
+            uint16_t address = registers[0];
+            while (machine->memory[address] != 0)
+            {
+                fputc(machine->memory[address] & 0xFF, machine->output);
+                address++;
+            }
+            return RUN_RUNNING;
+        }
+        case 0x23: // IN, prompt and echo
+            fputs("Input a character> ", machine->output);
+            fflush(machine->output);
+            registers[0] = (uint16_t)fgetc(machine->input);
+            fputc(registers[0] & 0xFF, machine->output);
+            return RUN_RUNNING;
+        case 0x24: // PUTSP, two characters per word, low byte first
+        {
+            uint16_t address = registers[0];
+            while (machine->memory[address] != 0)
+            {
+                fputc(machine->memory[address] & 0xFF, machine->output);
+                if (machine->memory[address] >> 8)
+                {
+                    fputc(machine->memory[address] >> 8, machine->output);
+                }
+                address++;
+            }
+            return RUN_RUNNING;
+        }
+        case 0x25: // HALT
+            fflush(machine->output);
+            return RUN_HALTED;
+        default:
+            LOG_ERROR("Error: Unknown trap vector x%02X at x%04X.\n", trapVector, (uint16_t)(machine->pc - 1));
+            return RUN_FAULT;
+    }
+}
+
+/*
+    Runs from the current PC until HALT, a fault, or instructionLimit
+    instructions (0 for no limit). Condition codes follow the current ISA,
+    so LEA leaves them alone. Memory-mapped device registers are not modeled,
+    I/O only goes through the traps.
+*/
+RunResult runMachine(Machine *machine, long long instructionLimit)
+{
+    uint16_t *registers = machine->registers;
+
+    while (instructionLimit == 0 || machine->executed < instructionLimit)
+    {
+        uint16_t pc = machine->pc;
+        const DecodedInstruction *instruction = &machine->decoded[pc];
+        machine->pc = (uint16_t)(pc + 1);
+        machine->executed++;
+
+        switch (instruction->opcode)
+        {
+            case OPCODE_ADD:
+                registers[instruction->dr] = registers[instruction->sr1] + (instruction->immediate ? (uint16_t)instruction->offset : registers[instruction->sr2]);
+                setConditions(machine, registers[instruction->dr]);
+                break;
+            case OPCODE_AND:
+                registers[instruction->dr] = registers[instruction->sr1] & (instruction->immediate ? (uint16_t)instruction->offset : registers[instruction->sr2]);
+                setConditions(machine, registers[instruction->dr]);
+                break;
+            case OPCODE_NOT:
+                registers[instruction->dr] = ~registers[instruction->sr1];
+                setConditions(machine, registers[instruction->dr]);
+                break;
+            case OPCODE_BR:
+                if (instruction->dr & machine->conditions)
+                {
+                    machine->pc = (uint16_t)(machine->pc + instruction->offset);
+                }
+                break;
+            case OPCODE_LD:
+                registers[instruction->dr] = machine->memory[(uint16_t)(machine->pc + instruction->offset)];
+                setConditions(machine, registers[instruction->dr]);
+                break;
+            case OPCODE_LDI:
+                registers[instruction->dr] = machine->memory[machine->memory[(uint16_t)(machine->pc + instruction->offset)]];
+                setConditions(machine, registers[instruction->dr]);
+                break;
+            case OPCODE_LDR:
+                registers[instruction->dr] = machine->memory[(uint16_t)(registers[instruction->sr1] + instruction->offset)];
+                setConditions(machine, registers[instruction->dr]);
+                break;
+            case OPCODE_LEA:
+                registers[instruction->dr] = (uint16_t)(machine->pc + instruction->offset);
+                break;
+            case OPCODE_ST:
+                storeMachineWord(machine, (uint16_t)(machine->pc + instruction->offset), registers[instruction->dr]);
+                break;
+            case OPCODE_STI:
+                storeMachineWord(machine, machine->memory[(uint16_t)(machine->pc + instruction->offset)], registers[instruction->dr]);
+                break;
+            case OPCODE_STR:
+                storeMachineWord(machine, (uint16_t)(registers[instruction->sr1] + instruction->offset), registers[instruction->dr]);
+                break;
+            case OPCODE_JMP:
+                machine->pc = registers[instruction->sr1];
+                break;
+            case OPCODE_JSR:
+            {
+                uint16_t target = instruction->immediate ? (uint16_t)(machine->pc + instruction->offset) : registers[instruction->sr1];
+                registers[7] = machine->pc;
+                machine->pc = target;
+                break;
+            }
+            case OPCODE_TRAP:
+            {
+                RunResult result = executeTrap(machine, instruction->offset);
+                if (result != RUN_RUNNING)
+                {
+                    return result;
+                }
+                break;
+            }
+            case OPCODE_RTI:
+                LOG_ERROR("Error: RTI at x%04X outside of supervisor mode.\n", pc);
+                return RUN_FAULT;
+            default:
+                LOG_ERROR("Error: Illegal opcode at x%04X.\n", pc);
+                return RUN_FAULT;
+        }
+    }
+    return RUN_LIMIT;
+}
+
+/*
+    Direct-threaded version of runMachine. Before running, every word of
+    memory gets the address of its handler, so the whole image is
+    translated up front. Each handler ends by jumping straight to the next
+    instruction's handler. There is no central switch, and every handler
+    has its own indirect jump for the branch predictor to learn. Stores
+    retarget the word they overwrite. Behaviour, including the instruction
+    count on every way out, matches runMachine.
+*/
+RunResult runThreaded(Machine *machine, long long instructionLimit)
+{
+#if LC3_THREADED_DISPATCH
+    static const void *const handlers[16] = {
+        [OPCODE_BR] = &&handleBR,
+        [OPCODE_ADD] = &&handleADD,
+        [OPCODE_LD] = &&handleLD,
+        [OPCODE_ST] = &&handleST,
+        [OPCODE_JSR] = &&handleJSR,
+        [OPCODE_AND] = &&handleAND,
+        [OPCODE_LDR] = &&handleLDR,
+        [OPCODE_STR] = &&handleSTR,
+        [OPCODE_RTI] = &&handleRTI,
+        [OPCODE_NOT] = &&handleNOT,
+        [OPCODE_LDI] = &&handleLDI,
+        [OPCODE_STI] = &&handleSTI,
+        [OPCODE_JMP] = &&handleJMP,
+        [OPCODE_RESERVED] = &&handleIllegal,
+        [OPCODE_LEA] = &&handleLEA,
+        [OPCODE_TRAP] = &&handleTRAP,
+    };
+
+    uint16_t *registers = machine->registers;
+    const DecodedInstruction *decoded = machine->decoded;
+    const void **threaded = machine->threaded;
+    const DecodedInstruction *instruction;
+    uint16_t pc = machine->pc;
+    uint16_t current;
+    uint16_t address;
+    RunResult result;
+
+    long long budget = instructionLimit == 0 ? LLONG_MAX : instructionLimit - machine->executed;
+    if (budget < 0)
+    {
+        budget = 0;
+    }
+    long long remaining = budget;
+
+    int word;
+    for (word = 0; word < LC3_MEMORY_WORDS; word++)
+    {
+        threaded[word] = handlers[decoded[word].opcode];
+    }
+
+    #define DISPATCH() do { \
+        if (remaining == 0) { result = RUN_LIMIT; goto finish; } \
+        remaining--; \
+        current = pc; \
+        instruction = &decoded[current]; \
+        pc = (uint16_t)(current + 1); \
+        goto *threaded[current]; \
+    } while (0)
+
+    #define STORE(target, value) do { \
+        address = (target); \
+        storeMachineWord(machine, address, (value)); \
+        threaded[address] = handlers[decoded[address].opcode]; \
+    } while (0)
+
+    DISPATCH();
+
+handleADD:
+    registers[instruction->dr] = registers[instruction->sr1] + (instruction->immediate ? (uint16_t)instruction->offset : registers[instruction->sr2]);
+    setConditions(machine, registers[instruction->dr]);
+    DISPATCH();
+handleAND:
+    registers[instruction->dr] = registers[instruction->sr1] & (instruction->immediate ? (uint16_t)instruction->offset : registers[instruction->sr2]);
+    setConditions(machine, registers[instruction->dr]);
+    DISPATCH();
+handleNOT:
+    registers[instruction->dr] = ~registers[instruction->sr1];
+    setConditions(machine, registers[instruction->dr]);
+    DISPATCH();
+handleBR:
+    if (instruction->dr & machine->conditions)
+    {
+        pc = (uint16_t)(pc + instruction->offset);
+    }
+    DISPATCH();
+handleLD:
+    registers[instruction->dr] = machine->memory[(uint16_t)(pc + instruction->offset)];
+    setConditions(machine, registers[instruction->dr]);
+    DISPATCH();
+handleLDI:
+    registers[instruction->dr] = machine->memory[machine->memory[(uint16_t)(pc + instruction->offset)]];
+    setConditions(machine, registers[instruction->dr]);
+    DISPATCH();
+handleLDR:
+    registers[instruction->dr] = machine->memory[(uint16_t)(registers[instruction->sr1] + instruction->offset)];
+    setConditions(machine, registers[instruction->dr]);
+    DISPATCH();
+handleLEA:
+    registers[instruction->dr] = (uint16_t)(pc + instruction->offset);
+    DISPATCH();
+handleST:
+    STORE((uint16_t)(pc + instruction->offset), registers[instruction->dr]);
+    DISPATCH();
+handleSTI:
+    STORE(machine->memory[(uint16_t)(pc + instruction->offset)], registers[instruction->dr]);
+    DISPATCH();
+handleSTR:
+    STORE((uint16_t)(registers[instruction->sr1] + instruction->offset), registers[instruction->dr]);
+    DISPATCH();
+handleJMP:
+    pc = registers[instruction->sr1];
+    DISPATCH();
+handleJSR:
+    address = instruction->immediate ? (uint16_t)(pc + instruction->offset) : registers[instruction->sr1];
+    registers[7] = pc;
+    pc = address;
+    DISPATCH();
+handleTRAP:
+    machine->pc = pc;
+    result = executeTrap(machine, instruction->offset);
+    if (result != RUN_RUNNING)
+    {
+        goto finish;
+    }
+    pc = machine->pc;
+    DISPATCH();
+handleRTI:
+    LOG_ERROR("Error: RTI at x%04X outside of supervisor mode.\n", current);
+    result = RUN_FAULT;
+    goto finish;
+handleIllegal:
+    LOG_ERROR("Error: Illegal opcode at x%04X.\n", current);
+    result = RUN_FAULT;
+    goto finish;
+
+    #undef DISPATCH
+    #undef STORE
+
+finish:
+    machine->pc = pc;
+    machine->executed += budget - remaining;
+    return result;
+#else
+    return runMachine(machine, instructionLimit);
+#endif
+}
+
+RunResult runProgram(Machine *machine, DispatchMode dispatch, long long instructionLimit)
+{
+    if (dispatch == DISPATCH_JIT)
+    {
+        JitState *jit = (JitState *)malloc(sizeof(JitState));
+        if (!jit)
+        {
+            fprintf(stderr, "Memory allocation failed.\n");
+            exit(EXIT_FAILURE);
+        }
+
+        RunResult result;
+        if (initJit(jit, JIT_DEFAULT_THRESHOLD))
+        {
+            result = runJit(machine, jit, instructionLimit);
+            LOG_TRACE("JIT compiled %lld blocks, dropped %lld.\n", jit->compiledBlocks, jit->droppedBlocks);
+            freeJit(jit);
+        }
+        else
+        {
+            // No executable memory here, the threaded interpreter is the next best thing
+            result = runThreaded(machine, instructionLimit);
+        }
+        free(jit);
+        return result;
+    }
+    return dispatch == DISPATCH_THREADED ? runThreaded(machine, instructionLimit) : runMachine(machine, instructionLimit);
+}
+
+#endif
@@ -0,0 +1,580 @@
+#ifndef SYMBOLS_H
+#define SYMBOLS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <stdint.h>
+
+#define SYMBOL_TABLE_INITIAL_CAPACITY 64
+
+// Binary symbol table file, big-endian like the object file
+#define SYMBOL_FILE_MAGIC "LSYM"
+#define SYMBOL_FILE_VERSION 1
+#define SYMBOL_FILE_HEADER_SIZE 16 // Magic, version, flags, record count, size of the name pool
+#define SYMBOL_RECORD_SIZE 12 // Address, name length, name offset, line number
+
+void initSymbolTable(SymbolTable *symbols, Arena *names)
+{
+    symbols->names = names;
+    symbols->entries = NULL;
+    symbols->count = 0;
+    symbols->capacity = 0;
+    symbols->buckets = NULL;
+    symbols->bucketCount = 0;
+}
+
+void freeSymbolTable(SymbolTable *symbols)
+{
+    free(symbols->entries);
+    free(symbols->buckets);
+    initSymbolTable(symbols, symbols->names);
+}
+
+// Empties the table but keeps its arrays, for filling it again with about as many labels
+void clearSymbolTable(SymbolTable *symbols)
+{
+    symbols->count = 0;
+    int i;
+    for (i = 0; i < symbols->bucketCount; i++)
+    {
+        symbols->buckets[i] = -1;
+    }
+}
+
+unsigned int hashLabel(const char *label, size_t length)
+{
+    // FNV-1a, good enough spread for short identifier strings
+    unsigned int hash = 2166136261u;
+    size_t i;
+    for (i = 0; i < length; i++)
+    {
+        hash ^= (unsigned char)label[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/*
+    Entries are stored densely in definition order, buckets hold indices
+    into entries (-1 when empty) and are probed linearly. The bucket array
+    is kept at most half full so probes stay short.
+*/
+void rehashSymbolTable(SymbolTable *symbols, int bucketCount)
+{
+    int *buckets = (int *)malloc(bucketCount * sizeof(int));
+    if (!buckets)
+    {
+        fprintf(stderr, "Memory allocation failed.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    int i;
+    for (i = 0; i < bucketCount; i++)
+    {
+        buckets[i] = -1;
+    }
+
+    for (i = 0; i < symbols->count; i++)
+    {
+        const char *label = symbols->entries[i].label;
+        unsigned int slot = hashLabel(label, strlen(label)) & (bucketCount - 1);
+        while (buckets[slot] != -1)
+        {
+            slot = (slot + 1) & (bucketCount - 1);
+        }
+        buckets[slot] = i;
+    }
+
+    free(symbols->buckets);
+    symbols->buckets = buckets;
+    symbols->bucketCount = bucketCount;
+}
+
+// Looks up a label that need not be null-terminated, such as a token view into the source
+LabelInfo *findSymbolView(SymbolTable *symbols, const char *label, size_t length)
+{
+    if (symbols->count == 0)
+    {
+        return NULL;
+    }
+
+    unsigned int slot = hashLabel(label, length) & (symbols->bucketCount - 1);
+    while (symbols->buckets[slot] != -1)
+    {
+        LabelInfo *entry = &symbols->entries[symbols->buckets[slot]];
+        if (strncmp(entry->label, label, length) == 0 && entry->label[length] == '\0')
+        {
+            return entry;
+        }
+        slot = (slot + 1) & (symbols->bucketCount - 1);
+    }
+    return NULL;
+}
+
+LabelInfo *findSymbol(SymbolTable *symbols, const char *label)
+{
+    return findSymbolView(symbols, label, strlen(label));
+}
+
+bool addLabel(SymbolTable *symbols, const char *label, size_t length, int lineNum, int address)
+{
+    // Check if the label already exists
+    if (findSymbolView(symbols, label, length) != NULL)
+    {
+        return false;
+    }
+
+    if (symbols->count == symbols->capacity)
+    {
+        int capacity = symbols->capacity ? symbols->capacity * 2 : SYMBOL_TABLE_INITIAL_CAPACITY;
+        LabelInfo *entries = (LabelInfo *)realloc(symbols->entries, capacity * sizeof(LabelInfo));
+        if (!entries)
+        {
+            fprintf(stderr, "Memory allocation failed.\n");
+            exit(EXIT_FAILURE);
+        }
+        symbols->entries = entries;
+        symbols->capacity = capacity;
+    }
+
+    // Add the new label
+    LabelInfo *entry = &symbols->entries[symbols->count++];
+    entry->label = arenaStrndup(symbols->names, label, length);
+    entry->lineNum = lineNum;
+    entry->address = address;
+
+    if (symbols->count * 2 > symbols->bucketCount)
+    {
+        rehashSymbolTable(symbols, symbols->bucketCount ? symbols->bucketCount * 2 : SYMBOL_TABLE_INITIAL_CAPACITY * 2);
+    }
+    else
+    {
+        unsigned int slot = hashLabel(entry->label, length) & (symbols->bucketCount - 1);
+        while (symbols->buckets[slot] != -1)
+        {
+            slot = (slot + 1) & (symbols->bucketCount - 1);
+        }
+        symbols->buckets[slot] = symbols->count - 1;
+    }
+    return true;
+}
+
+/*
+    Single-pass mode has no symbol table up front. A reference to a label
+    that is not defined yet is encoded with a zero offset and recorded as a
+    fixup against the output entry holding its word. Fixups for the same
+    label are chained through next, and the pending table maps each label
+    to the newest fixup in its chain (its address field holds the index,
+    -1 once resolved). When the label gets defined the whole chain is
+    patched at once, which lets the writer flush everything before the
+    oldest fixup that is still open.
+*/
+void initFixupList(FixupList *fixups, Arena *names)
+{
+    fixups->entries = NULL;
+    fixups->count = 0;
+    fixups->capacity = 0;
+    fixups->firstOpen = 0;
+    initSymbolTable(&fixups->pending, names);
+}
+
+void freeFixupList(FixupList *fixups)
+{
+    free(fixups->entries);
+    freeSymbolTable(&fixups->pending);
+    initFixupList(fixups, fixups->pending.names);
+}
+
+// Empties the list but keeps its arrays, like clearSymbolTable
+void clearFixupList(FixupList *fixups)
+{
+    fixups->count = 0;
+    fixups->firstOpen = 0;
+    clearSymbolTable(&fixups->pending);
+}
+
+void addFixup(FixupList *fixups, const char *label, int entryIndex, int address, int offsetBits)
+{
+    if (fixups->count == fixups->capacity)
+    {
+        int capacity = fixups->capacity ? fixups->capacity * 2 : SYMBOL_TABLE_INITIAL_CAPACITY;
+        Fixup *entries = (Fixup *)realloc(fixups->entries, capacity * sizeof(Fixup));
+        if (!entries)
+        {
+            fprintf(stderr, "Memory allocation failed.\n");
+            exit(EXIT_FAILURE);
+        }
+        fixups->entries = entries;
+        fixups->capacity = capacity;
+    }
+
+    LabelInfo *chain = findSymbol(&fixups->pending, label);
+    if (chain == NULL)
+    {
+        addLabel(&fixups->pending, label, strlen(label), 0, -1);
+        chain = findSymbol(&fixups->pending, label);
+    }
+
+    Fixup *fixup = &fixups->entries[fixups->count];
+    fixup->label = chain->label;
+    fixup->entryIndex = entryIndex;
+    fixup->address = address;
+    fixup->offsetBits = offsetBits;
+    fixup->next = chain->address;
+    fixup->resolved = false;
+    chain->address = fixups->count++;
+}
+
+// Computes the PC offset to a label, or defers it when single-pass mode has not seen the label yet
+bool resolveLabelOffset(SymbolTable *symbols, FixupList *fixups, OutputWriter *writer, const char *label, int currentAddress, int offsetBits, int *offset)
+{
+    const LabelInfo *target = lookupLabel(label, symbols);
+    if (target != NULL)
+    {
+        *offset = calculateOffset(target, currentAddress, offsetBits);
+        return true;
+    }
+
+    if (fixups != NULL)
+    {
+        // The word about to be emitted is the next output entry
+        addFixup(fixups, label, writer->entryBase + writer->entryCount, currentAddress, offsetBits);
+        *offset = 0;
+        return true;
+    }
+
+    LOG_ERROR("Error: Label '%s' not found.\n", label);
+    return false;
+}
+
+// Patches every reference made to target before it was defined
+void resolveFixups(FixupList *fixups, const LabelInfo *target, OutputWriter *writer)
+{
+    LabelInfo *chain = findSymbol(&fixups->pending, target->label);
+    if (chain == NULL)
+    {
+        return;
+    }
+
+    int index;
+    for (index = chain->address; index != -1; index = fixups->entries[index].next)
+    {
+        Fixup *fixup = &fixups->entries[index];
+        int offset = calculateOffset(target, fixup->address, fixup->offsetBits);
+        patchOutputEntry(writer, fixup->entryIndex, (uint16_t)((1 << fixup->offsetBits) - 1), (uint16_t)offset);
+        fixup->resolved = true;
+    }
+    chain->address = -1;
+
+    while (fixups->firstOpen < fixups->count && fixups->entries[fixups->firstOpen].resolved)
+    {
+        fixups->firstOpen++;
+    }
+}
+
+// Output entries before this one no longer wait on any fixup
+int firstOpenFixupEntry(const FixupList *fixups)
+{
+    return fixups->firstOpen < fixups->count ? fixups->entries[fixups->firstOpen].entryIndex : INT_MAX;
+}
+
+void reportUnresolvedFixups(const FixupList *fixups)
+{
+    int i;
+    for (i = fixups->firstOpen; i < fixups->count; i++)
+    {
+        const Fixup *fixup = &fixups->entries[i];
+        if (!fixup->resolved)
+        {
+            LOG_ERROR("Error: Label '%s' used at x%04X is never defined.\n", fixup->label, fixup->address);
+        }
+    }
+}
+
+// foo.obj or foo.bin becomes foo plus extension next to it, anything else just gets the extension appended
+char *symbolPathFor(const char *objectPath, const char *extension)
+{
+    size_t length = strlen(objectPath);
+    if (length > 4 && (strcmp(objectPath + length - 4, ".obj") == 0 || strcmp(objectPath + length - 4, ".bin") == 0))
+    {
+        length -= 4;
+    }
+
+    char *symbolPath = (char *)malloc(length + strlen(extension) + 1);
+    if (!symbolPath)
+    {
+        fprintf(stderr, "Memory allocation failed.\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(symbolPath, objectPath, length);
+    strcpy(symbolPath + length, extension);
+    return symbolPath;
+}
+
+void storeBigEndian(unsigned char *bytes, uint32_t value, int size)
+{
+    while (size-- > 0)
+    {
+        bytes[size] = (unsigned char)(value & 0xFF);
+        value >>= 8;
+    }
+}
+
+uint32_t loadBigEndian(const unsigned char *bytes, int size)
+{
+    uint32_t value = 0;
+    int i;
+    for (i = 0; i < size; i++)
+    {
+        value = (value << 8) | bytes[i];
+    }
+    return value;
+}
+
+// By address, labels sharing an address stay in source order
+int compareSymbolsByAddress(const void *a, const void *b)
+{
+    const LabelInfo *left = *(const LabelInfo *const *)a;
+    const LabelInfo *right = *(const LabelInfo *const *)b;
+    int leftAddress = left->address & 0xFFFF;
+    int rightAddress = right->address & 0xFFFF;
+    if (leftAddress != rightAddress)
+    {
+        return leftAddress < rightAddress ? -1 : 1;
+    }
+    return (left->lineNum > right->lineNum) - (left->lineNum < right->lineNum);
+}
+
+const LabelInfo **sortSymbolsByAddress(const SymbolTable *symbols)
+{
+    const LabelInfo **sorted = (const LabelInfo **)malloc((symbols->count > 0 ? symbols->count : 1) * sizeof(LabelInfo *));
+    if (!sorted)
+    {
+        fprintf(stderr, "Memory allocation failed.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    int i;
+    for (i = 0; i < symbols->count; i++)
+    {
+        sorted[i] = &symbols->entries[i];
+    }
+    qsort(sorted, symbols->count, sizeof(LabelInfo *), compareSymbolsByAddress);
+    return sorted;
+}
+
+/*
+    The binary table is a header, fixed-size records sorted by address and
+    a pool of null-terminated names, built in one buffer and written with a
+    single fwrite. A reader can map it and binary search the records in
+    place without parsing anything.
+*/
+bool writeSymbolTableFile(const LabelInfo **sorted, int count, const char *path)
+{
+    size_t namesSize = 0;
+    int i;
+    for (i = 0; i < count; i++)
+    {
+        namesSize += strlen(sorted[i]->label) + 1;
+    }
+
+    size_t size = SYMBOL_FILE_HEADER_SIZE + (size_t)count * SYMBOL_RECORD_SIZE + namesSize;
+    unsigned char *bytes = (unsigned char *)malloc(size);
+    if (!bytes)
+    {
+        fprintf(stderr, "Memory allocation failed.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    memcpy(bytes, SYMBOL_FILE_MAGIC, 4);
+    storeBigEndian(bytes + 4, SYMBOL_FILE_VERSION, 2);
+    storeBigEndian(bytes + 6, 0, 2);
+    storeBigEndian(bytes + 8, (uint32_t)count, 4);
+    storeBigEndian(bytes + 12, (uint32_t)namesSize, 4);
+
+    unsigned char *record = bytes + SYMBOL_FILE_HEADER_SIZE;
+    char *names = (char *)record + (size_t)count * SYMBOL_RECORD_SIZE;
+    size_t nameOffset = 0;
+    for (i = 0; i < count; i++)
+    {
+        size_t length = strlen(sorted[i]->label);
+        storeBigEndian(record, (uint32_t)(sorted[i]->address & 0xFFFF), 2);
+        storeBigEndian(record + 2, (uint32_t)(length > 0xFFFF ? 0xFFFF : length), 2);
+        storeBigEndian(record + 4, (uint32_t)nameOffset, 4);
+        storeBigEndian(record + 8, (uint32_t)sorted[i]->lineNum, 4);
+        memcpy(names + nameOffset, sorted[i]->label, length + 1);
+        nameOffset += length + 1;
+        record += SYMBOL_RECORD_SIZE;
+    }
+
+    FILE *file = fopen(path, "wb");
+    bool written = file != NULL && fwrite(bytes, 1, size, file) == size;
+    if (file != NULL && fclose(file) != 0)
+    {
+        written = false;
+    }
+    free(bytes);
+    return written;
+}
+
+// The usual LC-3 text layout, which readSymbolFile reads back
+bool writeSymbolTextFile(const LabelInfo **sorted, int count, const char *path)
+{
+    FILE *file = fopen(path, "w");
+    if (file == NULL)
+    {
+        return false;
+    }
+
+    fprintf(file, "// Symbol table\n");
+    fprintf(file, "// Scope level 0:\n");
+    fprintf(file, "//\tSymbol Name       Page Address\n");
+    fprintf(file, "//\t----------------  ------------\n");
+    int i;
+    for (i = 0; i < count; i++)
+    {
+        fprintf(file, "//\t%-16s  %04X\n", sorted[i]->label, sorted[i]->address & 0xFFFF);
+    }
+    fprintf(file, "\n");
+    return fclose(file) == 0;
+}
+
+// Writes the symbol files asked for in symbolExport next to outputPath
+bool exportSymbols(const SymbolTable *symbols, const char *outputPath, int symbolExport)
+{
+    if (symbolExport == SYMBOLS_NONE)
+    {
+        return true;
+    }
+    if (strcmp(outputPath, "-") == 0)
+    {
+        LOG_ERROR("Error: Symbol files are written next to the output file, none for stdout.\n");
+        return false;
+    }
+
+    const LabelInfo **sorted = sortSymbolsByAddress(symbols);
+    bool exported = true;
+    if (symbolExport & SYMBOLS_TABLE)
+    {
+        char *path = symbolPathFor(outputPath, ".lsym");
+        if (!writeSymbolTableFile(sorted, symbols->count, path))
+        {
+            LOG_ERROR("Error writing symbol table %s.\n", path);
+            exported = false;
+        }
+        free(path);
+    }
+    if (symbolExport & SYMBOLS_TEXT)
+    {
+        char *path = symbolPathFor(outputPath, ".sym");
+        if (!writeSymbolTextFile(sorted, symbols->count, path))
+        {
+            LOG_ERROR("Error writing symbol file %s.\n", path);
+            exported = false;
+        }
+        free(path);
+    }
+    free(sorted);
+    LOG_TRACE("Exported %d symbols.\n", symbols->count);
+    return exported;
+}
+
+/*
+    Loads a binary symbol table and checks that every record and name lies
+    inside the file, so lookups afterwards need no further checks.
+*/
+bool loadSymbolIndex(const char *path, SymbolIndex *index)
+{
+    index->data = NULL;
+    index->count = 0;
+
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (size < SYMBOL_FILE_HEADER_SIZE)
+    {
+        fclose(file);
+        return false;
+    }
+
+    unsigned char *data = (unsigned char *)malloc(size);
+    if (!data)
+    {
+        fprintf(stderr, "Memory allocation failed.\n");
+        exit(EXIT_FAILURE);
+    }
+    bool valid = fread(data, 1, size, file) == (size_t)size;
+    fclose(file);
+
+    uint32_t count = valid ? loadBigEndian(data + 8, 4) : 0;
+    uint32_t namesSize = valid ? loadBigEndian(data + 12, 4) : 0;
+    valid = valid && memcmp(data, SYMBOL_FILE_MAGIC, 4) == 0 && loadBigEndian(data + 4, 2) == SYMBOL_FILE_VERSION;
+    valid = valid && count <= (uint32_t)INT_MAX / SYMBOL_RECORD_SIZE && SYMBOL_FILE_HEADER_SIZE + (size_t)count * SYMBOL_RECORD_SIZE + namesSize == (size_t)size;
+    valid = valid && (namesSize == 0 || data[size - 1] == '\0');
+
+    const unsigned char *records = data + SYMBOL_FILE_HEADER_SIZE;
+    uint32_t i;
+    for (i = 0; valid && i < count; i++)
+    {
+        const unsigned char *record = records + (size_t)i * SYMBOL_RECORD_SIZE;
+        valid = loadBigEndian(record + 4, 4) < namesSize && (i == 0 || loadBigEndian(record - SYMBOL_RECORD_SIZE, 2) <= loadBigEndian(record, 2));
+    }
+    if (!valid)
+    {
+        free(data);
+        return false;
+    }
+
+    index->data = data;
+    index->count = (int)count;
+    index->records = records;
+    index->names = (const char *)records + (size_t)count * SYMBOL_RECORD_SIZE;
+    return true;
+}
+
+void freeSymbolIndex(SymbolIndex *index)
+{
+    free(index->data);
+    index->data = NULL;
+    index->count = 0;
+}
+
+uint16_t symbolIndexAddress(const SymbolIndex *index, int position)
+{
+    return (uint16_t)loadBigEndian(index->records + (size_t)position * SYMBOL_RECORD_SIZE, 2);
+}
+
+const char *symbolIndexName(const SymbolIndex *index, int position)
+{
+    return index->names + loadBigEndian(index->records + (size_t)position * SYMBOL_RECORD_SIZE + 4, 4);
+}
+
+// Binary search for the last symbol at or below address, the one a debugger shows as NAME+offset. -1 if there is none.
+int findSymbolAtAddress(const SymbolIndex *index, uint16_t address)
+{
+    int low = 0;
+    int high = index->count;
+    while (low < high)
+    {
+        int middle = low + (high - low) / 2;
+        if (symbolIndexAddress(index, middle) <= address)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    return low - 1;
+}
+
+#endif
@@ -9,468 +9,363 @@
 #include <stdbool.h>
 #include <ctype.h>
 #include <limits.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
-char peek(int offset, char *source, int *minIndex) 
+void initLexer(Lexer *lexer, const char *source, size_t length, Arena *scratch)
 {
-    int length = strlen(source);
-    if (*minIndex + offset >= length) 
-    {
-        return '\0';
-    }
-    return source[*minIndex + offset];
+    // The line is a view into the source, peek() stops at its length rather than a terminator
+    lexer->source = source;
+    lexer->length = (int)length;
+    lexer->index = 0;
+    lexer->scratch = scratch;
 }
 
-char consume(char *source, int *minIndex) 
+// Token buffers never need more room than the rest of the line, so size them from it
+char *allocTokenBuffer(Lexer *lexer)
 {
-    char ch = source[(*minIndex)++];
-    if (ch == '\n') 
-    {
-        printf("\nConsumed newline at index: %d, incrementing line count\n", *minIndex - 1);
-    } 
-    else 
-    {
-        printf("Consumed char: %c, at index: %d\n", ch, *minIndex - 1);
-    }
-    return ch;
+    return (char *)arenaAlloc(lexer->scratch, lexer->length - lexer->index + 1);
 }
 
-BinOps tokenToBinaryOp(Tokens token, const char *operands) 
+char peek(Lexer *lexer, int offset) 
 {
-    switch (token) 
+    if (lexer->index + offset >= lexer->length) 
     {
-        case ADD:
-            if (strstr(operands, "#") != NULL)
-            {
-                return ADD_TWO_OP;
-            }
-            else 
-            {
-                return ADD_ONE_OP;
-            }
-            break;
-        case AND:
-            if (strstr(operands, "#") != NULL)
-            {
-                return AND_TWO_OP;
-            }
-            else 
-            {
-                return AND_ONE_OP;
-            }
-            break;
-        case BR: 
-            return BR_OP;
-        case LD: 
-            return LD_OP;
-        case LDI: 
-            return LDI_OP;
-        case LDR: 
-            return LDR_OP;
-        case LEA: 
-            return LEA_OP;
-        case NOT: 
-            return NOT_OP;
-        case ST: 
-            return ST_OP;
-        case STI: 
-            return STI_OP;
-        case STR: 
-            return STR_OP;
-        case TRAP: 
-            return TRAP_OP;
-        default: 
-            return INVALID_OP;
+        return '\0';
     }
+    return lexer->source[lexer->index + offset];
 }
 
-bool addLabel(char labels[][MAX_LABEL_LEN], int* labelCount, const char* tokenBuffer) 
+char consume(Lexer *lexer) 
 {
-    // Check if the label already exists
-    int i;
-    for(i = 0; i < *labelCount; i++) 
+    char ch = lexer->source[lexer->index++];
+    if (LOG_ENABLED(VERBOSITY_TRACE))
     {
-        if(strcmp(labels[i], tokenBuffer) == 0) 
+        if (ch == '\n') 
+        {
+            fprintf(logStream, "\nConsumed newline at index: %d, incrementing line count\n", lexer->index - 1);
+        } 
+        else 
         {
-            return false; // Label already exists
+            fprintf(logStream, "Consumed char: %c, at index: %d\n", ch, lexer->index - 1);
         }
     }
-    // Add the new label
-    strcpy(labels[*labelCount], tokenBuffer);
-    (*labelCount)++;
-    return true;
+    return ch;
 }
 
-const char *getOpcodeForToken(BinOps binaryOps)
+/*
+    Lines come from a LineReader. A buffer reader walks source that is
+    already in memory (the two-pass path, which needs to read it twice).
+    A stream reader pulls fixed-size blocks with fread and only keeps the
+    unread tail plus the current line, so memory is bounded by the longest
+    line rather than the size of the input, and pipes work as well as files.
+*/
+void initBufferReader(LineReader *reader, const char *source, size_t length)
 {
-    int i;
-    for (i = 0; instructionMap[i].binaryOps != INVALID_OP; i++)
-    {
-        if (instructionMap[i].binaryOps == binaryOps)
-        {
-            return instructionMap[i].opcode;
-        }
-    }
-    return NULL;
+    reader->file = NULL;
+    reader->buffer = (char *)source;
+    reader->capacity = length;
+    reader->start = 0;
+    reader->end = length;
+    reader->eof = true;
 }
 
-const char *getBinValForRegister(RegisterTokens regTok)
+void initStreamReader(LineReader *reader, FILE *file)
 {
-    int i;
-    for (i = 0; registerMap[i].regTok != INVALID_REGISTER; i++)
+    reader->file = file;
+    reader->buffer = (char *)malloc(LINE_READER_BLOCK_SIZE);
+    if (!reader->buffer)
     {
-        if (registerMap[i].regTok == regTok)
-        {
-            return registerMap[i].binVal;
-        }
+        fprintf(stderr, "Memory allocation failed.\n");
+        exit(EXIT_FAILURE);
     }
-    return NULL;
+    reader->capacity = LINE_READER_BLOCK_SIZE;
+    reader->start = 0;
+    reader->end = 0;
+    reader->eof = false;
 }
 
-const char *getCommentForInstruction(BinOps binaryOps)
+// Only a buffer reader can go back to the beginning
+void rewindLineReader(LineReader *reader)
 {
-    int i;
-    for (i = 0; commentMap[i].binaryOps != INVALID_OP; i++)
+    reader->start = 0;
+}
+
+void freeLineReader(LineReader *reader)
+{
+    if (reader->file != NULL)
     {
-        if (commentMap[i].binaryOps == binaryOps)
-        {
-            return commentMap[i].comment;
-        }
+        free(reader->buffer);
     }
-    return NULL;
+    reader->buffer = NULL;
 }
 
-void processOperands(const char *operandsBuffer, char *binaryOut, Tokens tokenType, LabelInfo labelInfos[], int labelCount, int currentLine)
+// Hands out the next line, newline included; it stays valid until the following call
+bool nextLine(LineReader *reader, const char **line, size_t *lineLength)
 {
-    binaryOut[0] = '\0'; // Initialize the binaryOut buffer to an empty string
-    
-    switch (tokenType) 
+    for (;;)
     {
-        case AND: {
-            char drBuffer[256], srBuffer[256], immediateBuffer[256];
-            // Parse the operandsBuffer to extract DR, SR, and possibly an immediate value
-            int operandCount = sscanf(operandsBuffer, "%[^,],%[^,],%s", drBuffer, srBuffer, immediateBuffer);
-            
-            // Convert DR and SR to their binary representations
-            const char *binaryDR = getBinValForRegister(validateRegisterToken(drBuffer));
-            const char *binarySR = getBinValForRegister(validateRegisterToken(srBuffer));
-
-            // Begin constructing the binary output for AND instruction
-            strcat(binaryOut, binaryDR); // Append DR's binary representation
-            strcat(binaryOut, binarySR); // Append SR's binary representation
-
-            if (operandCount == 3) 
-            {
-                if (immediateBuffer[0] == '#') 
-                {
-                    strcat(binaryOut, "1"); // Append "1" to indicate immediate mode
-
-                    // Convert the immediate value to binary and append it
-                    char binaryImm[16];
-                    immToBinary(immediateBuffer, binaryImm, 5);
-                    strcat(binaryOut, binaryImm);
-                } 
-                else 
-                {
-                    printf("Non-immediate third operand!\n");
-                }
-            } 
-            else 
-            {
-                // If not using immediate mode, append "0" and five "0"s to complete the instruction format
-                // This case handles AND instructions that do not use immediate values (register mode)
-                strcat(binaryOut, "0"); // Append "0" to indicate register mode
-                strcat(binaryOut, "00000"); // Append five "0"s for padding
-            }
-            break;
-        }
-        case ADD: {
-            char drBuffer[256], sr1Buffer[256], secondOperandBuffer[256];
-            // Parse the operandsBuffer to extract DR, SR1, and either SR2 or an immediate value
-            int operandCount = sscanf(operandsBuffer, "%[^,],%[^,],%s", drBuffer, sr1Buffer, secondOperandBuffer);
-            
-            // Convert DR and SR1 to their binary representations
-            const char *binaryDR = getBinValForRegister(validateRegisterToken(drBuffer));
-            const char *binarySR1 = getBinValForRegister(validateRegisterToken(sr1Buffer));
-
-            // Begin constructing the binary output for ADD instruction
-            strcat(binaryOut, binaryDR); // Append DR's binary representation
-            strcat(binaryOut, binarySR1); // Append SR1's binary representation
-
-            if (operandCount == 3) 
-            {
-                if (secondOperandBuffer[0] == '#') 
-                {
-                    strcat(binaryOut, "1"); // Append "1" to indicate immediate mode
-
-                    // Convert the immediate value to binary and append it
-                    char binaryImm[16];
-                    immToBinary(secondOperandBuffer, binaryImm, 5);
-                    strcat(binaryOut, binaryImm);
-                } 
-                else 
-                {
-                    // Third operand is a register (SR2)
-                    strcat(binaryOut, "000"); // Append "000" to indicate it's a register operation
-                    const char *binarySR2 = getBinValForRegister(validateRegisterToken(secondOperandBuffer));
-                    strcat(binaryOut, binarySR2); // Append SR2's binary representation
-                }
-            } 
-            else 
-            {
-                printf("Operand count doesn't match expectations for ADD instruction.\n");
-            }
-            break;
-        }
-        case NOT: {
-            char drBuffer[256], srBuffer[256];
-            sscanf(operandsBuffer, "%[^,],%s", drBuffer, srBuffer); // Split operandsBuffer into DR and SR
-            
-            // Convert DR and SR to their binary representations
-            const char *binaryDR = getBinValForRegister(validateRegisterToken(drBuffer));
-            const char *binarySR = getBinValForRegister(validateRegisterToken(srBuffer));
-            
-            // Construct the binary instruction with "111111" appended
-            sprintf(binaryOut, "%s%s111111", binaryDR, binarySR);
-            break;
+        const char *start = reader->buffer + reader->start;
+        size_t available = reader->end - reader->start;
+        const char *newline = (const char *)memchr(start, '\n', available);
+
+        if (newline != NULL || (reader->eof && available > 0))
+        {
+            size_t size = newline ? (size_t)(newline - start) + 1 : available;
+            *line = start;
+            *lineLength = size;
+            reader->start += size;
+            return true;
         }
-        case LDR: {
-            char drBuffer[256], baseRBuffer[256], offsetBuffer[256];
-            // Parse the operandsBuffer to extract DR, BaseR, and offset
-            int operandCount = sscanf(operandsBuffer, "%[^,],%[^,],%s", drBuffer, baseRBuffer, offsetBuffer);
-            
-            // Convert DR and BaseR to their binary representations
-            const char *binaryDR = getBinValForRegister(validateRegisterToken(drBuffer));
-            const char *binaryBaseR = getBinValForRegister(validateRegisterToken(baseRBuffer));
-
-            // Begin constructing the binary output for LDR instruction
-            strcat(binaryOut, binaryDR); // Append DR's binary representation
-            strcat(binaryOut, binaryBaseR); // Append BaseR's binary representation
-
-            if (operandCount == 3) 
-            {
-                // Convert the offset value to a 6-bit binary and append it
-                char binaryOffset[16];
-                immToBinary(offsetBuffer, binaryOffset, 6);
-                strcat(binaryOut, binaryOffset);
-            } 
-            else 
-            {
-                printf("Operand count doesn't match expectations for LDR instruction.\n");
-            }
-            break;
+
+        if (reader->eof)
+        {
+            return false;
         }
-        case STR: {
-            char srBuffer[256], baseRBuffer[256], offsetBuffer[256];
-            // Parse the operandsBuffer to extract SR, BaseR, and offset
-            int operandCount = sscanf(operandsBuffer, "%[^,],%[^,],%s", srBuffer, baseRBuffer, offsetBuffer);
-            
-            // Convert SR and BaseR to their binary representations
-            const char *binarySR = getBinValForRegister(validateRegisterToken(srBuffer));
-            const char *binaryBaseR = getBinValForRegister(validateRegisterToken(baseRBuffer));
-
-            // Begin constructing the binary output for STR instruction
-            strcat(binaryOut, binarySR); // Append SR's binary representation
-            strcat(binaryOut, binaryBaseR); // Append BaseR's binary representation
-
-            if (operandCount == 3) 
-            {
-                // Convert the offset value to a 6-bit binary and append it
-                char binaryOffset[16];
-                immToBinary(offsetBuffer, binaryOffset, 6);
-                strcat(binaryOut, binaryOffset);
-            } 
-            else 
+
+        // Keep the partial line, move it to the front and read the next block behind it
+        memmove(reader->buffer, start, available);
+        reader->start = 0;
+        reader->end = available;
+        if (reader->end == reader->capacity)
+        {
+            char *grown = (char *)realloc(reader->buffer, reader->capacity * 2);
+            if (!grown)
             {
-                printf("Operand count doesn't match expectations for STR instruction.\n");
+                fprintf(stderr, "Memory allocation failed.\n");
+                exit(EXIT_FAILURE);
             }
-            break;
+            reader->buffer = grown;
+            reader->capacity *= 2;
         }
-        default: {
-            char operand[256];
-            int opIndex = 0; // Index to build up each operand string
-            int binIndex = 0; // Index for the binaryOut string
-            
-            int immediateSize = 5;
-
-            int i;
-            for (i = 0; operandsBuffer[i] != '\0'; i++) 
-            {
-                if (operandsBuffer[i] == ',' || operandsBuffer[i] == ' ') 
-                {
-                    if (opIndex > 0) 
-                    {
-                        operand[opIndex] = '\0'; // Null-terminate the current operand
-                        if (operand[0] == 'R') 
-                        {
-                            // Operand is a register
-                            const char *binaryReg = getBinValForRegister(validateRegisterToken(operand));
-                            strcat(binaryOut, binaryReg);
-                        } 
-                        else if (operand[0] == '#') 
-                        {
-                            // Operand is an immediate value
-                            char binaryImm[16];
-                            immToBinary(operand, binaryImm, immediateSize);
-                            strcat(binaryOut, binaryImm);
-                        }
-                        opIndex = 0; // Reset operand index for the next operand
-                    }
-                } 
-                else 
-                {
-                    operand[opIndex++] = operandsBuffer[i];
-                }
-            }
 
-            // Process the last operand, if any
-            if (opIndex > 0) 
-            {
-                operand[opIndex] = '\0'; // Null-terminate the last operand
-                if (operand[0] == 'R') 
-                {
-                    // Operand is a register
-                    const char *binaryReg = getBinValForRegister(validateRegisterToken(operand));
-                    strcat(binaryOut, binaryReg);
-                } 
-                else if (operand[0] == '#') 
-                {
-                    // Operand is an immediate value
-                    char binaryImm[16];
-                    immToBinary(operand, binaryImm, immediateSize);
-                    strcat(binaryOut, binaryImm);
-                }
-            }
-            break;
+        size_t bytesRead = fread(reader->buffer + reader->end, 1, reader->capacity - reader->end, reader->file);
+        reader->end += bytesRead;
+        if (bytesRead == 0)
+        {
+            reader->eof = true;
         }
     }
 }
 
-void immToBinary(const char *immStr, char *binaryOut, int immediateSize) 
+/*
+    Maps the whole input read-only so lines and tokens can be views into it
+    with no copy. Returns NULL for anything that cannot be mapped (pipes,
+    terminals, empty files); the caller then falls back to reading it.
+*/
+const char *mapInputFile(FILE *file, size_t *length)
 {
-    // Skip the '#' character to get the integer value
-    int immVal = atoi(immStr + 1);
-
-    // Calculate the maximum value based on the immediate size
-    int maxVal = (1 << (immediateSize - 1)) - 1;
-    int minVal = -maxVal - 1;
-
-    // Check if the value is within the valid range
-    if (immVal < minVal || immVal > maxVal) 
+    struct stat info;
+    int fd = fileno(file);
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size == 0)
     {
-        strcpy(binaryOut, "ERROR");
-        return;
+        return NULL;
     }
 
-    // Adjust the value for negative numbers to fit into the specified bit size
-    if (immVal < 0) 
+    void *mapping = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping == MAP_FAILED)
     {
-        immVal = (1 << immediateSize) + immVal;
+        return NULL;
     }
+    madvise(mapping, (size_t)info.st_size, MADV_SEQUENTIAL);
 
-    // Convert to binary representation
-    int i;
-    for (i = immediateSize - 1; i >= 0; i--) 
-    {
-        binaryOut[i] = (immVal & 1) ? '1' : '0';
-        immVal >>= 1;
-    }
-    binaryOut[immediateSize] = '\0';
+    *length = (size_t)info.st_size;
+    return (const char *)mapping;
+}
+
+void unmapInputFile(const char *source, size_t length)
+{
+    munmap((void *)source, length);
 }
 
-void writeLineToBin(const char *opcode, const char *binaryOut, const char *comment, FILE *binFile) 
+// Finds the next whitespace-separated token on a line without copying it
+bool nextTokenView(const char *line, size_t length, size_t *position, TokenView *token)
 {
-    // Determine if a space is needed between binary output and comment
-    int spaceNeeded = (strlen(binaryOut) > 0) ? 1 : 0;
-    // Calculate total length for the binary line
-    int totalLen = strlen(opcode) + strlen(binaryOut) + strlen(comment) + spaceNeeded + 2; // +2 for newline and null terminator
-
-    // Allocate memory for the binary line
-    char *binaryLine = (char *)malloc(totalLen * sizeof(char));
-    if (!binaryLine) 
+    while (*position < length && isspace((unsigned char)line[*position]))
     {
-        fprintf(stderr, "Memory allocation failed.\n");
-        exit(EXIT_FAILURE);
+        (*position)++;
+    }
+    if (*position >= length)
+    {
+        return false;
     }
 
-    // Format the binary line combining opcode, binary output, and comment
-    snprintf(binaryLine, totalLen, "%s%s%s%s\n", opcode, binaryOut, spaceNeeded ? " " : "", comment);
-    // Write to file
-    fwrite(binaryLine, sizeof(char), strlen(binaryLine), binFile);
-    // Free allocated memory
-    free(binaryLine);
+    token->start = line + *position;
+    while (*position < length && !isspace((unsigned char)line[*position]))
+    {
+        (*position)++;
+    }
+    token->length = (size_t)(line + *position - token->start);
+    return true;
 }
 
-void hexToBinary(unsigned int hex, char *binary, int bits) 
+bool viewEquals(TokenView token, const char *text)
 {
-    binary[bits] = '\0';
-    int i;
-    for (i = bits - 1; i >= 0; i--) 
+    return strlen(text) == token.length && memcmp(token.start, text, token.length) == 0;
+}
+
+/*
+    strtol on a view: reads the leading digits only, so it never runs past
+    the token. Stops at 0x10000 once the digits no longer fit in a word, so
+    callers' range checks reject the value instead of the int wrapping.
+*/
+int viewToInt(TokenView token, int base)
+{
+    size_t i = 0;
+    bool negative = false;
+    if (i < token.length && (token.start[i] == '-' || token.start[i] == '+'))
     {
-        binary[i] = (hex & 1) ? '1' : '0';
-        hex >>= 1;
+        negative = token.start[i++] == '-';
+    }
+
+    int value = 0;
+    for (; i < token.length; i++)
+    {
+        int digit;
+        char ch = token.start[i];
+        if (isdigit((unsigned char)ch)) digit = ch - '0';
+        else if (isxdigit((unsigned char)ch)) digit = tolower((unsigned char)ch) - 'a' + 10;
+        else break;
+        if (digit >= base) break;
+        value = value * base + digit;
+        if (value > 0xFFFF)
+        {
+            value = 0x10000;
+            break;
+        }
     }
+    return negative ? -value : value;
 }
 
-void convertLineNumToBin(int lineNum, char *binaryRepresentation, int bits) 
+/*
+    Decodes a double-quoted string literal starting at *position (leading
+    whitespace skipped) and leaves *position after the closing quote.
+    Understands \n \t \r \0 \\ \" and \'. Writes the characters to out
+    when it is not NULL, so the first pass can use it just to measure.
+    Returns the decoded length, or -1 for a malformed literal.
+*/
+int decodeStringLiteral(const char *text, size_t length, size_t *position, char *out)
 {
-    // Initialize all bits to '0'
-    for (int i = 0; i < bits; i++) 
+    size_t i = *position;
+    while (i < length && isspace((unsigned char)text[i]))
     {
-        binaryRepresentation[i] = '0';
+        i++;
     }
-    binaryRepresentation[bits] = '\0'; // Null-terminate the string
+    if (i >= length || text[i] != '"')
+    {
+        return -1;
+    }
+    i++;
 
-    // Convert lineNum to binary representation
-    for (int i = bits - 1; i >= 0 && lineNum > 0; i--) 
+    int count = 0;
+    while (i < length && text[i] != '"')
     {
-        binaryRepresentation[i] = (lineNum % 2) + '0';
-        lineNum /= 2;
+        char ch = text[i++];
+        if (ch == '\n')
+        {
+            return -1; // Unterminated
+        }
+        if (ch == '\\')
+        {
+            if (i >= length)
+            {
+                return -1;
+            }
+            switch (text[i++])
+            {
+                case 'n': ch = '\n'; break;
+                case 't': ch = '\t'; break;
+                case 'r': ch = '\r'; break;
+                case '0': ch = '\0'; break;
+                case '\\': ch = '\\'; break;
+                case '"': ch = '"'; break;
+                case '\'': ch = '\''; break;
+                default: return -1;
+            }
+        }
+        if (out != NULL)
+        {
+            out[count] = ch;
+        }
+        count++;
     }
+    if (i >= length)
+    {
+        return -1; // No closing quote
+    }
+
+    *position = i + 1;
+    return count;
 }
 
-int calculateOffset(const char* targetLabel, LabelInfo labels[], int labelCount, int currentAddress) 
+const char *getOpcodeForToken(BinOps binaryOps)
 {
-    int targetAddress = -1;
-    for (int i = 0; i < labelCount; i++) 
+    int i;
+    for (i = 0; instructionMap[i].binaryOps != INVALID_OP; i++)
     {
-        if (strcmp(labels[i].label, targetLabel) == 0) 
+        if (instructionMap[i].binaryOps == binaryOps)
         {
-            targetAddress = labels[i].address;
-            break;
+            return instructionMap[i].opcode;
         }
     }
+    return NULL;
+}
 
-    if (targetAddress == -1) 
+const char *getBinValForRegister(RegisterTokens regTok)
+{
+    int i;
+    for (i = 0; registerMap[i].regTok != INVALID_REGISTER; i++)
     {
-        printf("Error: Label '%s' not found.\n", targetLabel);
-        return INT_MIN; // Signal error
+        if (registerMap[i].regTok == regTok)
+        {
+            return registerMap[i].binVal;
+        }
     }
+    return NULL;
+}
 
-    // Calculate the offset. Note: currentAddress points to the BR instruction itself.
-    printf("Current Address: x%X\n", currentAddress);
-    printf("Target Address: x%X\n", targetAddress);
-    int offset = (targetAddress - (currentAddress + 2)) / 2; // Adjust for PC pointing to next instruction
-
-    return offset;
+const char *getCommentForInstruction(BinOps binaryOps)
+{
+    int i;
+    for (i = 0; commentMap[i].binaryOps != INVALID_OP; i++)
+    {
+        if (commentMap[i].binaryOps == binaryOps)
+        {
+            return commentMap[i].comment;
+        }
+    }
+    return NULL;
 }
 
-void intToBinary(int value, char *binaryOut, int size) 
+int calculateOffset(const LabelInfo *target, int currentAddress, int offsetBits) 
 {
-    if (value < 0) 
+    if (target == NULL) 
     {
-        // Calculate two's complement for negative numbers
-        value = (1 << size) + value; // Adding value (which is negative) to 2^size gives the two's complement
+        LOG_ERROR("Error: Label not found.\n");
+        return INT_MIN; // Signal error
     }
+    int targetAddress = target->address;
 
-    int mask = 1 << (size - 1); // Start with the most significant bit
+    // Calculate the offset. Note: currentAddress points to the instruction itself.
+    LOG_TRACE("Current Address: x%X\n", currentAddress);
+    LOG_TRACE("Target Address: x%X\n", targetAddress);
+    int offset = targetAddress - (currentAddress + 1); // Adjust for PC pointing to next instruction
 
-    for (int i = 0; i < size; i++) 
+    if (!fitsInBits(offset, offsetBits)) 
     {
-        binaryOut[i] = (value & mask) ? '1' : '0';
-        mask >>= 1;
+        LOG_ERROR("Error: Label '%s' is %d words away, out of range for a %d-bit PC offset.\n", target->label, offset, offsetBits);
     }
 
-    binaryOut[size] = '\0'; // Null-terminate the string
+    return offset;
+}
+
+// Seconds on the monotonic clock, for timing stages of the library and the benchmarks alike
+double monotonicSeconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -8,124 +8,109 @@
 #include <stdbool.h>
 #include <ctype.h>
 
-Tokens validateToken(const char *token) 
+/*
+    Mnemonics and directives are classified by length first and then by
+    their first character, so any token costs a couple of character
+    compares and at most one short memcmp instead of a strcmp against
+    every entry. The accepted spellings are exactly the ones the original
+    strcmp chain took (kept in benchmarks.h for comparison).
+*/
+Tokens validateTokenView(const char *token, size_t length)
 {
-    if (strcmp(token, "ADD") == 0)
-    {
-        return ADD;
-    }
-    else if (strcmp(token, "AND") == 0)
-    {
-        return AND;
-    }
-    else if (strncmp(token, "BR", 2) == 0 && strlen(token) == 2) 
-    {
-        return BR;
-    }
-    else if (strcmp(token, "LD") == 0)
-    {
-        return LD;
-    }
-    else if (strcmp(token, "LDI") == 0)
-    {
-        return LDI;
-    }
-    else if (strcmp(token, "LDR") == 0)
-    {
-        return LDR;
-    }
-    else if (strcmp(token, "LEA") == 0)
-    {
-        return LEA;
-    }
-    else if (strcmp(token, "NOT") == 0)
-    {
-        return NOT;
-    }
-    else if (strcmp(token, "ST") == 0)
-    {
-        return ST;
-    }
-    else if (strcmp(token, "STI") == 0)
-    {
-        return STI;
-    }
-    else if (strcmp(token, "STR") == 0)
-    {
-        return STR;
-    }
-    else if (strcmp(token, "TRAP") == 0)
-    {
-        return TRAP;
-    }
-    else if (strcmp(token, "ORIG") == 0)
-    {
-        return ORIG;
-    }
-    else if (strcmp(token, "END") == 0)
-    {
-        return END;
-    }
-    else if (strcmp(token, "#") == 0)
-    {
-        return HASH;
-    }
-    else if (strcmp(token, ";") == 0)
-    {
-        return SEMI;
-    }
-    else if (strcmp(token, "BLKW") == 0)
-    {
-        return BLKW;
-    }
-    else if (strcmp(token, ".FILL") == 0)
-    {
-        return FILL;
-    }
-    else 
-    {
-        return INVALID_TOKEN;
+    switch (length)
+    {
+        case 1:
+            if (token[0] == '#') return HASH;
+            if (token[0] == ';') return SEMI;
+            break;
+        case 2:
+            if (token[0] == 'B' && token[1] == 'R') return BR;
+            if (token[0] == 'I' && token[1] == 'N') return IN;
+            if (token[0] == 'L' && token[1] == 'D') return LD;
+            if (token[0] == 'S' && token[1] == 'T') return ST;
+            break;
+        case 3:
+            switch (token[0])
+            {
+                case 'A':
+                    if (token[1] == 'D' && token[2] == 'D') return ADD;
+                    if (token[1] == 'N' && token[2] == 'D') return AND;
+                    break;
+                case 'E':
+                    if (token[1] == 'N' && token[2] == 'D') return END;
+                    break;
+                case 'J':
+                    if (token[1] == 'M' && token[2] == 'P') return JMP;
+                    if (token[1] == 'S' && token[2] == 'R') return JSR;
+                    break;
+                case 'L':
+                    if (token[1] == 'D' && token[2] == 'I') return LDI;
+                    if (token[1] == 'D' && token[2] == 'R') return LDR;
+                    if (token[1] == 'E' && token[2] == 'A') return LEA;
+                    break;
+                case 'N':
+                    if (token[1] == 'O' && token[2] == 'T') return NOT;
+                    break;
+                case 'O':
+                    if (token[1] == 'U' && token[2] == 'T') return OUT;
+                    break;
+                case 'R':
+                    if (token[1] == 'E' && token[2] == 'T') return RET;
+                    if (token[1] == 'T' && token[2] == 'I') return RTI;
+                    break;
+                case 'S':
+                    if (token[1] == 'T' && token[2] == 'I') return STI;
+                    if (token[1] == 'T' && token[2] == 'R') return STR;
+                    break;
+            }
+            break;
+        case 4:
+            switch (token[0])
+            {
+                case 'B':
+                    if (memcmp(token, "BLKW", 4) == 0) return BLKW;
+                    break;
+                case 'G':
+                    if (memcmp(token, "GETC", 4) == 0) return GETC;
+                    break;
+                case 'H':
+                    if (memcmp(token, "HALT", 4) == 0) return HALT;
+                    break;
+                case 'J':
+                    if (memcmp(token, "JSRR", 4) == 0) return JSRR;
+                    break;
+                case 'O':
+                    if (memcmp(token, "ORIG", 4) == 0) return ORIG;
+                    break;
+                case 'P':
+                    if (memcmp(token, "PUTS", 4) == 0) return PUTS;
+                    break;
+                case 'T':
+                    if (memcmp(token, "TRAP", 4) == 0) return TRAP;
+                    break;
+            }
+            break;
+        case 5:
+            if (memcmp(token, ".FILL", 5) == 0) return FILL;
+            if (memcmp(token, "PUTSP", 5) == 0) return PUTSP;
+            break;
     }
+    return INVALID_TOKEN;
+}
+
+Tokens validateToken(const char *token) 
+{
+    return validateTokenView(token, strlen(token));
 }
 
+// Registers are exactly R0 to R7, and RegisterTokens values match the register numbers
 RegisterTokens validateRegisterToken(const char *regstr)
 {
-    if (strcmp(regstr, "R0") == 0)
-    {
-        return R0;
-    }
-    else if (strcmp(regstr, "R1") == 0)
-    {
-        return R1;
-    }
-    else if (strcmp(regstr, "R2") == 0)
+    if (regstr[0] == 'R' && regstr[1] >= '0' && regstr[1] <= '7' && regstr[2] == '\0')
     {
-        return R2;
-    }
-    else if (strcmp(regstr, "R3") == 0)
-    {
-        return R3;
-    }
-    else if (strcmp(regstr, "R4") == 0)
-    {
-        return R4;
-    }
-    else if (strcmp(regstr, "R5") == 0)
-    {
-        return R5;
-    }
-    else if (strcmp(regstr, "R6") == 0)
-    {
-        return R6;
-    }
-    else if (strcmp(regstr, "R7") == 0)
-    {
-        return R7;
-    }
-    else
-    {
-        return INVALID_REGISTER;
+        return (RegisterTokens)(regstr[1] - '0');
     }
+    return INVALID_REGISTER;
 }
 
 bool isRegister(char *token)
@@ -173,20 +158,17 @@ bool isValidBranchCondition(char condition)
     return false;
 }
 
-bool isValidLabel(char *label, char labels[][MAX_LABEL_LEN], int count) 
+LabelInfo *lookupLabel(const char *label, SymbolTable *symbols) 
 {
-    printf("Validating label: %s\n", label);
-    int i;
-    for (i = 0; i < count; i++) 
+    LOG_TRACE("Validating label: %s\n", label);
+    LabelInfo *entry = findSymbol(symbols, label);
+    if (entry != NULL) 
     {
-        if (strcmp(label, labels[i]) == 0) 
-        {
-            printf("Label found and valid: %s\n", label);
-            return true;
-        }
+        LOG_TRACE("Label found and valid: %s\n", label);
+        return entry;
     }
-    printf("Label not found: %s\n", label);
-    return false;
+    LOG_TRACE("Label not found: %s\n", label);
+    return NULL;
 }
 
 bool isLabelDefinition(char *token)
@@ -198,6 +180,45 @@ bool isLabelDefinition(char *token)
     return false;
 }
 
+bool isInstructionOrDirective(const char *token)
+{
+    return token[0] == '.' || validateToken(token) != INVALID_TOKEN || isBRInstruction((char *)token);
+}
+
+bool isInstructionOrDirectiveView(TokenView token)
+{
+    if (token.length > 0 && token.start[0] == '.')
+    {
+        return true;
+    }
+    if (validateTokenView(token.start, token.length) != INVALID_TOKEN)
+    {
+        return true;
+    }
+
+    // Same rule as isBRInstruction: BR followed by any run of n, z and p
+    if (token.length < 2 || token.start[0] != 'B' || token.start[1] != 'R')
+    {
+        return false;
+    }
+    size_t i;
+    for (i = 2; i < token.length; i++)
+    {
+        if (token.start[i] != 'n' && token.start[i] != 'z' && token.start[i] != 'p')
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Same rule as isSoloLabel: the only colon is the last character
+bool isSoloLabelView(TokenView token)
+{
+    const char *colon = (const char *)memchr(token.start, ':', token.length);
+    return colon != NULL && colon == token.start + token.length - 1;
+}
+
 bool isBRInstruction(char *token) 
 {
     // Check if token starts with "BR" and optionally followed by any of 'n', 'z', 'p'.
@@ -216,21 +237,6 @@ bool isBRInstruction(char *token)
     return false; // Token does not start with "BR".
 }
 
-bool isOffset6(char *offset) 
-{
-    if (offset[0] != '#') 
-    {
-        return false;
-    }
-
-    int val = atoi(offset + 1); 
-    if (val >= -32 && val <= 31) 
-    {
-        return true;
-    }
-    return false;
-}
-
 bool isValidTrapVector(const char *offset) 
 {
     unsigned int val;